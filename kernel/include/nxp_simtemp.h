@@ -17,63 +17,365 @@
  * This structure is defined to store the temperature sample.
  */
 struct simtemp_sample {
-    __u64 timestamp_ns;   // monotonic timestamp
+    __u64 timestamp_ns;   // Device timestamp clock, CLOCK_REALTIME by
+                          // default, see SIMTEMP_IOC_GET_CLOCK
     __u32 temp_mC;        // milli-degree Celsius (e.g., 44123 = 44.123 °C)
-    __u16 flags;          // bit0=NEW_SAMPLE, bit1=THRESHOLD_CROSSED
+    __u16 flags;          // bit0=NEW_SAMPLE, bit1=THRESHOLD_CROSSED,
+                          // bit2=DATA_GAP
     __u16 padding;
 } __attribute__((packed));
 
+/*
+ * Record formats a file can select for read() with SIMTEMP_IOC_SET_FORMAT.
+ *
+ * SIMTEMP_FMT_LEGACY:  struct simtemp_sample, 16 bytes (default).
+ * SIMTEMP_FMT_COMPACT: struct simtemp_sample_compact, 8 bytes. delta_us is
+ *                      relative to the last sync record. A sync record has
+ *                      SIMTEMP_SYNC in its flags, a delta_us of 0 and is
+ *                      followed by the absolute __u64 timestamp_ns of that
+ *                      sample (16 bytes in total). The driver emits one
+ *                      first and then every SIMTEMP_SYNC_INTERVAL records
+ *                      or whenever the delta does not fit.
+ * SIMTEMP_FMT_RAW:     __u32 temp_flags only, 4 bytes, for consumers that
+ *                      know the sampling period.
+ *
+ * temp_flags packs temp_mC in bits 0..23 and the sample flags in 24..31.
+ *
+ * The formats only change what read() returns. The shared history keeps
+ * struct simtemp_sample entries, encoding happens while copying out.
+ */
+#define SIMTEMP_FMT_LEGACY    0
+#define SIMTEMP_FMT_COMPACT   1
+#define SIMTEMP_FMT_RAW       2
+
+#define SIMTEMP_TEMP_MASK     0x00ffffffU
+#define SIMTEMP_FLAGS_SHIFT   24
+#define SIMTEMP_SYNC          (1 << 7)  // Compact flag, a timestamp follows
+#define SIMTEMP_SYNC_INTERVAL 64
+
+struct simtemp_sample_compact {
+    __u32 delta_us;       // Microseconds since the last sync record
+    __u32 temp_flags;     // temp_mC | flags << SIMTEMP_FLAGS_SHIFT
+} __attribute__((packed));
+
+struct simtemp_sample_sync {
+    struct simtemp_sample_compact rec;  // rec flags include SIMTEMP_SYNC
+    __u64 timestamp_ns;
+} __attribute__((packed));
+
+/*
+ * Header page of the shared sample ring exposed through mmap().
+ *
+ * The ring is mapped read-only at offset SIMTEMP_MMAP_RING_OFFSET; slot 0
+ * starts data_offset bytes into the mapping. The driver writes the sample
+ * with sequence number `head` into slot (head & (size - 1)) and then
+ * publishes head + 1 with release semantics. Each consumer keeps its own
+ * tail:
+ *
+ *   head = load_acquire(&hdr->head);
+ *   if (head - tail > size - 1) -> overrun, tail = head - (size - 1)
+ *   copy slots [tail, head), then re-load head: a copied slot with
+ *   sequence s is only valid while (head - s) < size.
+ *
+ * With the "overwrite" overflow policy the driver may rewrite the newest
+ * slot (head - 1) in place instead of publishing a new one. rewrite_seq is
+ * odd while that happens; a consumer that copied slot head - 1 discards the
+ * copy if rewrite_seq was odd or changed meanwhile.
+ *
+ * To let poll() report POLLIN for a mapped consumer, the consumer also maps
+ * its per-file control page at SIMTEMP_MMAP_CTRL_OFFSET and stores its tail
+ * there after consuming samples.
+ */
+struct simtemp_ring_header {
+    __u32 version;        // SIMTEMP_RING_VERSION
+    __u32 size;           // Number of sample slots, power of two
+    __u32 data_offset;    // Byte offset of slot 0 from the mapping start
+    __u32 sample_size;    // sizeof(struct simtemp_sample)
+    __u64 head;           // Sequence number of the next sample to publish
+    __u64 rewrite_seq;    // Odd while the newest slot is rewritten
+};
+
+/*
+ * Per-file control page, written by the consumer.
+ */
+struct simtemp_ring_ctrl {
+    __u64 tail;           // Sequence number of the next sample to consume
+};
+
+#define SIMTEMP_RING_VERSION      2
+#define SIMTEMP_MMAP_RING_OFFSET  0x00000000UL
+#define SIMTEMP_MMAP_CTRL_OFFSET  0x10000000UL
+
 /* Mode definitions */
 enum {
-    MODE_NORMAL,
-    MODE_RAMP
+    MODE_NORMAL,    // Uniform random values below the threshold
+    MODE_RAMP,      // Normal with periodic threshold crossings
+    MODE_SINE,      // Sine around the threshold
+    MODE_SAWTOOTH,  // Rising ramp through the threshold, then drop
+    MODE_STEP,      // Square wave below/above the threshold
+    MODE_NOISE,     // Random noise on a baseline below the threshold
+    MODE_REPLAY     // Play back the records written to the device
+};
+
+/* What the producer does when the slowest reader has a full backlog */
+enum {
+    OVERFLOW_DROP_OLDEST,  // Publish anyway, lagging readers lose old samples
+    OVERFLOW_DROP_NEWEST,  // Discard the new sample
+    OVERFLOW_OVERWRITE     // Replace the newest retained sample in place
+};
+
+/* Sample generation execution contexts */
+enum {
+    GEN_CTX_HARDIRQ,     // hrtimer expiring in hardirq context
+    GEN_CTX_SOFTIRQ,     // hrtimer expiring in softirq context
+    GEN_CTX_KTHREAD      // Dedicated SCHED_FIFO kernel thread
+};
+
+/* Sample timestamp clocks, the _FAST ones use the NMI-safe accessors */
+enum {
+    TSCLK_REALTIME,            // CLOCK_REALTIME, the default
+    TSCLK_MONOTONIC,           // CLOCK_MONOTONIC
+    TSCLK_MONOTONIC_RAW,       // CLOCK_MONOTONIC_RAW
+    TSCLK_BOOTTIME,            // CLOCK_BOOTTIME
+    TSCLK_TAI,                 // CLOCK_TAI
+    TSCLK_REALTIME_FAST,
+    TSCLK_MONOTONIC_FAST,
+    TSCLK_MONOTONIC_RAW_FAST,
+    TSCLK_BOOTTIME_FAST,
+    TSCLK_TAI_FAST
 };
 
 /* Flags for struct simtemp_sample */
 #define NEW_SAMPLE         (1 << 0)
 #define THRESHOLD_CROSSED  (1 << 1)
+#define DATA_GAP           (1 << 2)  // Samples were lost right before this one
 
-#define MIN_SAMPLE_MS  10              // Minimun time in ms for sampling
+#define MIN_SAMPLE_NS  1000ULL         // Minimum sampling period, 1 MHz
+#define MAX_SAMPLE_NS  (3600ULL * 1000000000ULL) // Maximum, one hour
+#define MIN_TIMER_NS   100000ULL       // Shortest timer period, shorter
+                                       // sampling periods are batched
 #define RAMP_START     10              // Low limit before start crossing
                                        // the threshold
 #define RAMP_STOP      RAMP_START + 5  // Upper limit before restart the
                                        // crossing threshold
-#define KFIFO_SIZE     256             // Number of samples
+#define WAVE_STEPS     256             // Samples per waveform period
+#define WAVE_AMPLITUDE_MC 5000         // Waveform swing around threshold
+#define NOISE_MC       500             // Noise around the noise baseline
+#define DEFAULT_WINDOW_MS 1000         // Aggregation window length
+#define MIN_WINDOW_MS  1               // Shortest configurable window
+#define MAX_WINDOW_MS  3600000         // Longest configurable window
+#define REPLAY_DEPTH   1024            // Records queued for replay
+#define ALERT_DEPTH    64              // Alerts kept per device, power of 2
+#define DEFAULT_RING_SIZE 256          // Samples kept in the shared
+                                       // history, power of 2
+#define MIN_RING_SIZE  16              // Smallest configurable depth
+#define MAX_RING_SIZE  (1U << 20)      // Largest configurable depth
 
-#define DEFAULT_SAMPLE_MS      100     // Default sampling time
+#define DEFAULT_SAMPLE_US      100000  // Default sampling time
 #define DEFAULT_THRESHOLD_MC   45000   // Default milli-degree threshold
+#define DEFAULT_HYSTERESIS_MC  1000    // Drop below threshold to re-arm
 
 /* Device specific parameters */
 #define DRIVER_NAME       "simtemp"
 #define PLATFORM_DEV_NAME DRIVER_NAME
 #define DEVICE_NODE       DRIVER_NAME
+#define DEVICE_NODE_FMT   DEVICE_NODE"%d"
+#define MAX_DEVICES       1024      // Upper limit for the nr_devices parameter
 
-#define DEVICE_FILE "/dev/"DEVICE_NODE
+#define DEVICE_FILE "/dev/"DEVICE_NODE"0"
 #define DEVICE_PATH "/sys/devices/platform/"PLATFORM_DEV_NAME
 
 #ifdef __KERNEL__
+#include "nxp_simtemp_ioctl.h"  // For struct simtemp_alert
+
+/* Configuration fields reported by the config_changed trace event */
+enum simtemp_cfg_field {
+    SIMTEMP_CFG_SAMPLING_NS,
+    SIMTEMP_CFG_THRESHOLD_MC,
+    SIMTEMP_CFG_MODE,
+    SIMTEMP_CFG_OVERFLOW_POLICY,
+    SIMTEMP_CFG_SEED,
+    SIMTEMP_CFG_HYSTERESIS_MC,
+    SIMTEMP_CFG_CLOCK,
+    SIMTEMP_CFG_FIFO_DEPTH,
+    SIMTEMP_CFG_WINDOW_MS,
+    SIMTEMP_CFG_REPLAY_SPEED,
+    SIMTEMP_CFG_GEN_CONTEXT,
+    SIMTEMP_CFG_GEN_CPU,      /* -1 (any CPU) is reported as U32_MAX */
+};
+
+/* Per-CPU counters, reported through struct simtemp_counters */
+enum simtemp_stat {
+    SIMTEMP_STAT_SAMPLES_DROPPED,
+    SIMTEMP_STAT_READS,
+    SIMTEMP_STAT_BYTES_READ,
+    SIMTEMP_STAT_WAKEUPS,
+    SIMTEMP_STAT_POLLS,
+    SIMTEMP_STAT_EMPTY_READS,
+    SIMTEMP_STAT_TIMER_OVERRUNS,
+    SIMTEMP_STAT_CONFIG_CHANGES,
+    SIMTEMP_STAT_NR
+};
+
+/*
+ * Counters of one CPU. Only that CPU writes them, with interrupts off, so
+ * updates never contend. syncp lets 32-bit readers see whole values.
+ */
+struct simtemp_pcpu_stats {
+    u64 cnt[SIMTEMP_STAT_NR];
+    struct u64_stats_sync syncp;
+};
+
+/* Log2 buckets, the last one also holds everything above 2^30 ns */
+#define SIMTEMP_HIST_BUCKETS 32
+
+/*
+ * Log2-bucketed histogram of nanosecond values.
+ */
+struct simtemp_hist {
+    u64 buckets[SIMTEMP_HIST_BUCKETS];
+    u64 count;
+    u64 sum_ns;
+    u64 max_ns;
+};
+
+/* Moving average of the temperature, 8 fractional bits, weight 1/16 */
+DECLARE_EWMA(simtemp_temp, 8, 16)
+
+/*
+ * Incremental statistics of one aggregation window. Sums are kept relative
+ * to the first sample so the squares stay small.
+ */
+struct simtemp_window {
+    u64 start_ns;
+    u64 end_ns;
+    u32 count;
+    u32 above;
+    u32 min_mC;
+    u32 max_mC;
+    u32 base_mC;  /* First sample of the window */
+    s64 sum;      /* Sum of (temp - base) */
+    u64 sum_sq;   /* Sum of (temp - base)^2 */
+    u32 ewma_mC;
+};
+
+/*
+ * Structure to hold per-file data.
+ */
+struct simtemp_file {
+    struct simtemp_dev *sdev;
+    struct list_head node;  /* In sdev->readers, walked under RCU */
+    struct rcu_head rcu;
+    struct simtemp_ring_ctrl *ctrl; /* Control page, allocated on mmap() */
+    bool ring_mapped; /* Counted in sdev->ring_mappers */
+    bool consuming;   /* Read or mapped the ring, see simtemp_ring_full() */
+    struct mutex read_lock; /* Serializes read() on this file */
+    u64 tail;     /* Next sample read() returns, shared with ctrl->tail */
+    u64 overruns; /* Samples overwritten before this file read them */
+    struct simtemp_hist latency; /* Age of the samples read() returned */
+    u32 format;       /* SIMTEMP_FMT_* of read() and write() */
+    void *bounce;     /* Encoding buffer of the non legacy formats */
+    u64 sync_ns;      /* Timestamp of the last compact sync record */
+    u32 since_sync;   /* Compact records since the last sync */
+    u64 write_sync_ns; /* Last compact sync record written, 0 if none */
+    u64 alert_tail;   /* Sequence number of the next alert to return */
+    wait_queue_head_t wait;  /* Blocking read() and poll() of this file */
+    u32 lowat;               /* Samples queued before a wakeup */
+    u64 max_latency_ns;      /* Deadline of a partial backlog, 0 if none */
+    struct hrtimer deadline; /* Armed by the producer for max_latency_ns */
+    u64 expired_tail;        /* Tail the deadline expired at */
+    bool released;           /* Closed, never arm the deadline again */
+};
+
 /*
  * Structure to hold device-specific data.
  */
 struct simtemp_dev {
-    struct miscdevice *miscdev;
+    struct miscdevice miscdev;
+    char name[16];  /* Misc node name, DEVICE_NODE_FMT */
+    int index;
     struct hrtimer temp_hrtimer;
-    wait_queue_head_t read_wait;
-    wait_queue_head_t poll_wait;
-    DECLARE_KFIFO(kfifo, struct simtemp_sample, KFIFO_SIZE);
-    spinlock_t lock; /* Protects access to kfifo */
+    spinlock_t lock; /* Serializes configuration updates */
+    seqcount_t period_seq; /* Lockless period snapshot for the producer */
+    struct rw_semaphore ring_rwsem; /* Excludes read()/mmap() from resizes */
+    struct simtemp_ring_header *ring; /* Shared history, vmalloc_user() */
+    struct simtemp_sample *ring_data;
+    u32 ring_size;          /* Slots in the ring, power of 2 */
+    u64 head;               /* Copy of ring->head for lockless waiters */
+    atomic_t ring_mappers;  /* Files that mapped the ring, block resizes */
     struct device *dev;
 
-    u32 sampling_ms;
+    u64 sampling_ns;
+    u32 samples_per_tick; /* Samples produced on every timer expiry */
+    ktime_t tick_period;  /* sampling_ns * samples_per_tick */
+
+    struct mutex gen_lock; /* Serializes generator start/stop */
+    u32 gen_context;       /* GEN_CTX_* */
+    int gen_cpu;           /* CPU the kthread is bound to, -1 for any */
+    struct task_struct *gen_thread;
+
+    struct simtemp_hist jitter; /* Tick lateness versus programmed expiry */
+    u64 missed_periods;         /* Periods skipped by late ticks */
+    bool jitter_reset;          /* Applied by the generator on its next tick */
+    struct dentry *debugfs;
+
+    u32 overflow_policy;         /* OVERFLOW_* */
+    u32 clock;                   /* TSCLK_* of the sample timestamps */
+    spinlock_t readers_lock;     /* Serializes sdev->readers updates */
+    struct list_head readers;    /* Open files, for the backlog check */
+    bool gap_pending;            /* Flag the next published sample */
+    atomic64_t dropped_oldest;   /* Samples lost by lagging read() files */
+    u64 dropped_newest;          /* Samples discarded by the producer */
+    u64 overwritten;             /* Samples replaced in place */
+
+    spinlock_t latency_lock;     /* Readers of all files update it */
+    struct simtemp_hist latency; /* Age of the samples read() returned */
+
     u32 threshold_mC;
+    u32 hysteresis_mC;
+    bool alert_active;  /* Hysteresis state, producer only */
+    struct simtemp_alert alerts[ALERT_DEPTH]; /* Transitions, producer only */
+    u64 alert_head;     /* Sequence number of the next alert */
     u32 mode;
     u32 current_temp;
     u16 current_flags;
 
     u64 samples_taken;
     u64 threshold_alerts;
+    struct simtemp_pcpu_stats __percpu *stats; /* SIMTEMP_STAT_* counters */
 
     u32 counter;
+
+    struct rnd_state rng; /* Seedable generator PRNG, producer only */
+    u32 phase;            /* Waveform position, 0..WAVE_STEPS - 1 */
+    u64 seed;
+    bool reseed;          /* Applied by the producer on its next sample */
+
+    DECLARE_KFIFO_PTR(replay, struct simtemp_sample); /* write() -> producer */
+    struct mutex replay_lock;     /* Serializes writers of the replay queue */
+    wait_queue_head_t replay_wait; /* Writers waiting for queue space */
+    void *replay_buf;             /* PAGE_SIZE copy of the user records */
+    u32 replay_speed;             /* Playback multiplier, 0 = no pacing */
+    bool replay_running;          /* Timing base below is valid */
+    u64 replay_base_ns;           /* Monotonic time of the first record */
+    u64 replay_base_ts;           /* Timestamp of the first record */
+    u64 replayed;
+
+    seqcount_t agg_seq;             /* Consistent snapshots for readers */
+    u32 window_ms;
+    struct simtemp_window win_cur;  /* Producer only, besides snapshots */
+    struct simtemp_window win_last;
+    struct ewma_simtemp_temp ewma;
+
+    struct work_struct nl_work;  /* Netlink publishing, queued per tick */
+    u64 nl_tail;                 /* Next sample to multicast */
+    u64 nl_alert_tail;           /* Next alert to multicast */
+
+    struct iio_dev *indio_dev;   /* IIO front-end, NULL without IIO */
+    struct iio_trigger *iio_trig; /* Fired by iio_work, once per tick */
+    struct work_struct iio_work; /* Feeds the IIO buffer, queued per tick */
+    u64 iio_tail;                /* Next sample to push into the buffer */
+    struct device *hwmon;        /* hwmon front-end, NULL without hwmon */
 };
 #endif
 
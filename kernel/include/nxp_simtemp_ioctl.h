@@ -20,8 +20,196 @@ struct simtemp_config {
     __u32 mode;
 };
 
+/* Delivery latency of the samples returned by read() on one file */
+#define SIMTEMP_LATENCY_BUCKETS 32
+struct simtemp_latency {
+    __u64 count;
+    __u64 mean_ns;
+    __u64 max_ns;
+    /* Percentiles, upper bound of the log2 bucket that holds them */
+    __u64 p50_ns;
+    __u64 p90_ns;
+    __u64 p99_ns;
+    __u64 p999_ns;
+    /* Bucket i counts ages in [2^(i-1), 2^i) ns, bucket 0 counts zero */
+    __u64 buckets[SIMTEMP_LATENCY_BUCKETS];
+};
+
+/* Summary of the samples of one aggregation window */
+struct simtemp_window_stats {
+    __u64 start_ns;       // Timestamp of the first sample
+    __u64 end_ns;         // Timestamp of the last sample
+    __u64 variance_mC2;   // Population variance in (milli-degree C)^2
+    __u32 count;          // Samples in the window
+    __u32 above;          // Samples at or above the threshold
+    __u32 min_mC;
+    __u32 max_mC;
+    __u32 mean_mC;
+    __u32 ewma_mC;        // Moving average at the last sample
+};
+
+/* Rolling statistics maintained by the driver */
+struct simtemp_aggregate {
+    __u32 window_ms;      // Window length, windows are back to back
+    __u32 ewma_mC;        // Moving average of every sample, weight 1/16
+    struct simtemp_window_stats last;     // Last completed window
+    struct simtemp_window_stats current;  // Window in progress
+};
+
+/* Wakeup coalescing of one file, applies to blocking read() and poll() */
+struct simtemp_wakeup {
+    __u32 lowat;          // Wake up once this many samples are queued, >= 1
+    __u32 reserved;       // Must be zero
+    __u64 max_latency_ns; // Wake up anyway once a sample waited this long,
+                          // 0 waits for lowat samples
+};
+
+/*
+ * Versioned control and telemetry structs. The kernel fills in the version
+ * it implements, SIMTEMP_IOC_SET_FIELDS only accepts the current one.
+ * struct simtemp_latest needs nxp_simtemp.h included first.
+ */
+#define SIMTEMP_DEV_CONFIG_VERSION 1
+#define SIMTEMP_DEV_STATS_VERSION  1
+#define SIMTEMP_LATEST_VERSION     1
+#define SIMTEMP_COUNTERS_VERSION   1
+
+/* Fields of struct simtemp_dev_config, selected by its mask */
+#define SIMTEMP_CFG_F_SAMPLING_NS     (1U << 0)
+#define SIMTEMP_CFG_F_THRESHOLD_MC    (1U << 1)
+#define SIMTEMP_CFG_F_HYSTERESIS_MC   (1U << 2)
+#define SIMTEMP_CFG_F_MODE            (1U << 3)
+#define SIMTEMP_CFG_F_OVERFLOW_POLICY (1U << 4)
+#define SIMTEMP_CFG_F_FIFO_DEPTH      (1U << 5)
+#define SIMTEMP_CFG_F_GEN_CONTEXT     (1U << 6)   // gen_context and gen_cpu
+#define SIMTEMP_CFG_F_WINDOW_MS       (1U << 7)
+#define SIMTEMP_CFG_F_REPLAY_SPEED    (1U << 8)
+#define SIMTEMP_CFG_F_SEED            (1U << 9)
+#define SIMTEMP_CFG_F_ALL             ((1U << 10) - 1)
+
+/* Whole device configuration, every sysfs attribute in one struct */
+struct simtemp_dev_config {
+    __u32 version;          // SIMTEMP_DEV_CONFIG_VERSION
+    __u32 mask;             // SIMTEMP_CFG_F_*, fields valid or to apply
+    __u64 sampling_ns;
+    __u64 seed;
+    __u32 threshold_mC;
+    __u32 hysteresis_mC;
+    __u32 mode;             // MODE_*
+    __u32 overflow_policy;  // OVERFLOW_*
+    __u32 fifo_depth;       // Rounded up to a power of 2
+    __u32 gen_context;      // GEN_CTX_*
+    __s32 gen_cpu;          // -1 for any
+    __u32 window_ms;
+    __u32 replay_speed;
+    __u32 reserved;         // Must be zero
+};
+
+/* Device counters, plus the position of the calling file */
+struct simtemp_dev_stats {
+    __u32 version;          // SIMTEMP_DEV_STATS_VERSION
+    __u32 reserved;
+    __u64 samples_taken;
+    __u64 threshold_alerts;
+    __u64 dropped_oldest;
+    __u64 dropped_newest;
+    __u64 overwritten;
+    __u64 replayed;
+    __u64 missed_periods;
+    __u64 head;             // Sequence number of the next sample
+    __u64 overruns;         // Samples the calling file lost
+    __u64 queued;           // Samples the calling file has not read yet
+};
+
+/* Newest sample, read without consuming it */
+struct simtemp_latest {
+    __u32 version;          // SIMTEMP_LATEST_VERSION
+    __u32 reserved;
+    __u64 seq;              // Sequence number of the sample
+    struct simtemp_sample sample;
+};
+
+/* Event counters, summed over the per-CPU copies of the device */
+struct simtemp_counters {
+    __u32 version;          // SIMTEMP_COUNTERS_VERSION
+    __u32 reserved;
+    __u64 samples_dropped;  // Lost by lagging files, dropped or overwritten
+    __u64 reads;            // read() calls that returned data
+    __u64 bytes_read;       // Bytes those calls returned
+    __u64 wakeups;          // Wakeups issued to waiting files
+    __u64 polls;            // poll() calls
+    __u64 empty_reads;      // Non-blocking read() calls with nothing queued
+    __u64 timer_overruns;   // Generator ticks that missed periods
+    __u64 config_changes;   // Configuration updates applied
+};
+
+/* Clock of the sample timestamps */
+struct simtemp_clock {
+    __u32 clock;            // TSCLK_*, the only field SET_CLOCK reads
+    __s32 clockid;          // Same clock for clock_gettime(), e.g. CLOCK_TAI
+    __u32 fast;             // 1 if read through the NMI-safe accessor
+    __u32 reserved;
+};
+
+/* Threshold crossing, one per transition of the hysteresis state */
+#define SIMTEMP_ALERT_RISING  1   // Reached threshold_mC
+#define SIMTEMP_ALERT_FALLING 2   // Dropped below threshold_mC - hysteresis_mC
+struct simtemp_alert {
+    __u64 timestamp_ns;   // Timestamp of the sample that crossed
+    __u32 temp_mC;
+    __u32 type;           // SIMTEMP_ALERT_*
+    __u32 threshold_mC;   // Threshold the sample was compared with
+    __u32 lost;           // Alerts overwritten before this file read them
+};
+
 /* IOCTL command definitions */
 #define SIMTEMP_IOC_MAGIC 'T'
 #define SIMTEMP_IOC_SET_ALL _IOW(SIMTEMP_IOC_MAGIC, 1, struct simtemp_config)
+/* Samples this file lost because the history wrapped before it read them */
+#define SIMTEMP_IOC_GET_OVERRUNS _IOR(SIMTEMP_IOC_MAGIC, 2, __u64)
+/* Sampling period in nanoseconds */
+#define SIMTEMP_IOC_SET_SAMPLING_NS _IOW(SIMTEMP_IOC_MAGIC, 3, __u64)
+/* Produce-to-deliver latency of this file */
+#define SIMTEMP_IOC_GET_LATENCY \
+    _IOR(SIMTEMP_IOC_MAGIC, 4, struct simtemp_latency)
+/* Number of samples kept in the shared history, rounded up to a power of 2 */
+#define SIMTEMP_IOC_SET_FIFO_DEPTH _IOW(SIMTEMP_IOC_MAGIC, 5, __u32)
+/* Record format of read() on this file, SIMTEMP_FMT_* */
+#define SIMTEMP_IOC_SET_FORMAT _IOW(SIMTEMP_IOC_MAGIC, 6, __u32)
+#define SIMTEMP_IOC_GET_FORMAT _IOR(SIMTEMP_IOC_MAGIC, 7, __u32)
+/* Rolling statistics, see struct simtemp_aggregate */
+#define SIMTEMP_IOC_GET_AGGREGATE \
+    _IOR(SIMTEMP_IOC_MAGIC, 8, struct simtemp_aggregate)
+/* Oldest unread alert of this file, -EAGAIN when there is none */
+#define SIMTEMP_IOC_GET_ALERT _IOR(SIMTEMP_IOC_MAGIC, 9, struct simtemp_alert)
+/* Wakeup watermark and deadline of this file, see struct simtemp_wakeup */
+#define SIMTEMP_IOC_SET_WAKEUP \
+    _IOW(SIMTEMP_IOC_MAGIC, 10, struct simtemp_wakeup)
+#define SIMTEMP_IOC_GET_WAKEUP \
+    _IOR(SIMTEMP_IOC_MAGIC, 11, struct simtemp_wakeup)
+/* Whole configuration, see struct simtemp_dev_config */
+#define SIMTEMP_IOC_GET_CONFIG \
+    _IOR(SIMTEMP_IOC_MAGIC, 12, struct simtemp_dev_config)
+/*
+ * Apply the fields selected by mask, nothing if one of them is invalid or
+ * fifo_depth changes while the ring is mapped (EBUSY). Running out of memory
+ * while applying can still leave the fields applied before it.
+ */
+#define SIMTEMP_IOC_SET_FIELDS \
+    _IOW(SIMTEMP_IOC_MAGIC, 13, struct simtemp_dev_config)
+#define SIMTEMP_IOC_GET_STATS \
+    _IOR(SIMTEMP_IOC_MAGIC, 14, struct simtemp_dev_stats)
+/* Newest sample, -EAGAIN before the first one */
+#define SIMTEMP_IOC_GET_LATEST \
+    _IOR(SIMTEMP_IOC_MAGIC, 15, struct simtemp_latest)
+/* Discard the samples this file has not read yet */
+#define SIMTEMP_IOC_FLUSH _IO(SIMTEMP_IOC_MAGIC, 16)
+#define SIMTEMP_IOC_GET_COUNTERS \
+    _IOR(SIMTEMP_IOC_MAGIC, 17, struct simtemp_counters)
+/* Timestamp clock, compare samples with clock_gettime(clockid) directly */
+#define SIMTEMP_IOC_GET_CLOCK \
+    _IOR(SIMTEMP_IOC_MAGIC, 18, struct simtemp_clock)
+#define SIMTEMP_IOC_SET_CLOCK \
+    _IOW(SIMTEMP_IOC_MAGIC, 19, struct simtemp_clock)
 
 #endif  // KERNEL_INCLUDE_NXP_SIMTEMP_IOCTL_H_
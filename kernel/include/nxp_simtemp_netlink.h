@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * nxp_simtemp_netlink.h - Generic netlink interface of a kernel mode driver
+ *                         simulating a temperature sensor.
+ *
+ * Copyright (c) 2025 Eduardo Vaca <edu.daniel.vs@gmail.com>
+ *
+ * See README.md for more information.
+ */
+
+#ifndef KERNEL_INCLUDE_NXP_SIMTEMP_NETLINK_H_
+#define KERNEL_INCLUDE_NXP_SIMTEMP_NETLINK_H_
+
+/* Family and multicast groups, resolve their ids through the genl controller */
+#define SIMTEMP_NL_FAMILY_NAME      "simtemp"
+#define SIMTEMP_NL_VERSION          1
+#define SIMTEMP_NL_GRP_SAMPLES_NAME "samples"
+#define SIMTEMP_NL_GRP_ALERTS_NAME  "alerts"
+
+#define SIMTEMP_NL_BATCH 128  // Samples per SIMTEMP_NL_CMD_SAMPLES at most
+
+/* Multicast groups, in registration order */
+enum simtemp_nl_group {
+    SIMTEMP_NL_GRP_SAMPLES,     // Batches of samples
+    SIMTEMP_NL_GRP_ALERTS,      // Threshold transitions
+};
+
+/* Commands, all of them are multicast notifications */
+enum simtemp_nl_cmd {
+    SIMTEMP_NL_CMD_UNSPEC,
+    SIMTEMP_NL_CMD_SAMPLES,     // DEVICE, FIRST_SEQ, LOST, SAMPLES
+    SIMTEMP_NL_CMD_ALERT,       // DEVICE, ALERT
+    __SIMTEMP_NL_CMD_MAX,
+};
+#define SIMTEMP_NL_CMD_MAX (__SIMTEMP_NL_CMD_MAX - 1)
+
+enum simtemp_nl_attr {
+    SIMTEMP_NL_ATTR_UNSPEC,
+    SIMTEMP_NL_ATTR_PAD,
+    SIMTEMP_NL_ATTR_DEVICE,     // u32, N of /dev/simtemp<N>
+    SIMTEMP_NL_ATTR_FIRST_SEQ,  // u64, sequence number of the first sample
+    SIMTEMP_NL_ATTR_LOST,       // u64, samples skipped before this batch
+    SIMTEMP_NL_ATTR_SAMPLES,    // struct simtemp_sample array
+    SIMTEMP_NL_ATTR_ALERT,      // struct simtemp_alert
+    __SIMTEMP_NL_ATTR_MAX,
+};
+#define SIMTEMP_NL_ATTR_MAX (__SIMTEMP_NL_ATTR_MAX - 1)
+
+#endif  // KERNEL_INCLUDE_NXP_SIMTEMP_NETLINK_H_
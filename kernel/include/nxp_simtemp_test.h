@@ -14,8 +14,43 @@
 
 #include <linux/types.h>
 
+#define SAMPLES_PER_READ  64   // Samples drained per read() in poll mode
+#define URING_ENTRIES     8    // Submission queue entries of the io_uring
+#define NL_BUF_SIZE       8192 // Receive buffer of the netlink listener
+
+/* Netlink attribute walking, the tool does not depend on libnl */
+#define NL_ATTR_DATA(nla) ((void *)((char *)(nla) + NLA_HDRLEN))
+#define NL_ATTR_LEN(nla)  ((int)(nla)->nla_len - NLA_HDRLEN)
+#define NL_GENL_ATTRS(nlh) \
+    ((struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN))
+#define NL_GENL_ATTRLEN(nlh) \
+    ((int)(nlh)->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN))
+#define nl_for_each_attr(nla, head, len, rem)                              \
+    for (nla = (head), rem = (len);                                        \
+        rem >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN &&                 \
+        nla->nla_len <= rem;                                               \
+        rem -= NLA_ALIGN(nla->nla_len),                                    \
+        nla = (struct nlattr *)((char *)nla + NLA_ALIGN(nla->nla_len)))
+
 /* --- Prototypes --- */
 void ns_to_iso8601(__u64 ns, char* buffer, size_t size);
 void print_help(char *prog_name);
+void print_sample(const struct simtemp_sample *sample);
+void print_alert(const struct simtemp_alert *alert);
+void print_records(const char *buf, size_t len, __u32 format,
+    __u64 *sync_ns);
+void print_latency(const struct simtemp_latency *lat);
+void print_window(const char *name, const struct simtemp_window_stats *win);
+int run_ring_loop(int fd);
+int run_uring_reader(int fd, long count);
+int run_splice(int fd, long count, const char *path);
+int nl_resolve_group(int sock, const char *group, __u16 *family_id);
+int run_netlink_listener(const char *group);
+int set_config_field(struct simtemp_dev_config *cfg, char *pair);
+int run_clock(int fd, const char *clock);
+void print_device(const struct simtemp_dev_config *cfg,
+    const struct simtemp_dev_stats *stats,
+    const struct simtemp_counters *counters,
+    const struct simtemp_latest *latest);
 
 #endif  // KERNEL_INCLUDE_NXP_SIMTEMP_TEST_H_
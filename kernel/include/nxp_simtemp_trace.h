@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * nxp_simtemp_trace.h - Trace events for a kernel mode driver simulating a
+ *                       temperature sensor.
+ *
+ * Copyright (c) 2025 Eduardo Vaca <edu.daniel.vs@gmail.com>
+ *
+ * See README.md for more information.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM simtemp
+
+#if !defined(KERNEL_INCLUDE_NXP_SIMTEMP_TRACE_H_) || \
+    defined(TRACE_HEADER_MULTI_READ)
+#define KERNEL_INCLUDE_NXP_SIMTEMP_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+#include "nxp_simtemp.h"
+
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_SAMPLING_NS);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_THRESHOLD_MC);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_MODE);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_OVERFLOW_POLICY);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_SEED);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_HYSTERESIS_MC);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_CLOCK);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_FIFO_DEPTH);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_WINDOW_MS);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_REPLAY_SPEED);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_GEN_CONTEXT);
+TRACE_DEFINE_ENUM(SIMTEMP_CFG_GEN_CPU);
+
+#define show_simtemp_cfg(field)                                 \
+    __print_symbolic(field,                                     \
+        { SIMTEMP_CFG_SAMPLING_NS,  "sampling_ns" },            \
+        { SIMTEMP_CFG_THRESHOLD_MC, "threshold_mC" },           \
+        { SIMTEMP_CFG_MODE,         "mode" },                   \
+        { SIMTEMP_CFG_OVERFLOW_POLICY, "overflow_policy" },     \
+        { SIMTEMP_CFG_SEED,         "seed" },                   \
+        { SIMTEMP_CFG_HYSTERESIS_MC, "hysteresis_mC" },         \
+        { SIMTEMP_CFG_CLOCK,        "clock" },                  \
+        { SIMTEMP_CFG_FIFO_DEPTH,   "fifo_depth" },             \
+        { SIMTEMP_CFG_WINDOW_MS,    "window_ms" },              \
+        { SIMTEMP_CFG_REPLAY_SPEED, "replay_speed" },           \
+        { SIMTEMP_CFG_GEN_CONTEXT,  "gen_context" },            \
+        { SIMTEMP_CFG_GEN_CPU,      "gen_cpu" })
+
+/* A sample was published into the shared history */
+TRACE_EVENT(sample_produced,
+    TP_PROTO(int index, u64 seq, const struct simtemp_sample *sample),
+    TP_ARGS(index, seq, sample),
+    TP_STRUCT__entry(
+        __field(int, index)
+        __field(u64, seq)
+        __field(u64, timestamp_ns)
+        __field(u32, temp_mC)
+        __field(u16, flags)
+    ),
+    TP_fast_assign(
+        __entry->index = index;
+        __entry->seq = seq;
+        __entry->timestamp_ns = sample->timestamp_ns;
+        __entry->temp_mC = sample->temp_mC;
+        __entry->flags = sample->flags;
+    ),
+    TP_printk("simtemp%d seq=%llu ts=%llu temp=%u mC flags=0x%02x",
+        __entry->index, __entry->seq, __entry->timestamp_ns,
+        __entry->temp_mC, __entry->flags)
+);
+
+/* The history wrapped past a reader, which lost `lost` samples */
+TRACE_EVENT(sample_dropped,
+    TP_PROTO(int index, u64 tail, u64 lost),
+    TP_ARGS(index, tail, lost),
+    TP_STRUCT__entry(
+        __field(int, index)
+        __field(u64, tail)
+        __field(u64, lost)
+    ),
+    TP_fast_assign(
+        __entry->index = index;
+        __entry->tail = tail;
+        __entry->lost = lost;
+    ),
+    TP_printk("simtemp%d tail=%llu lost=%llu",
+        __entry->index, __entry->tail, __entry->lost)
+);
+
+/* A sample changed the hysteresis state, rising or falling */
+TRACE_EVENT(threshold_crossed,
+    TP_PROTO(int index, u32 temp_mC, u32 threshold_mC, bool rising),
+    TP_ARGS(index, temp_mC, threshold_mC, rising),
+    TP_STRUCT__entry(
+        __field(int, index)
+        __field(u32, temp_mC)
+        __field(u32, threshold_mC)
+        __field(bool, rising)
+    ),
+    TP_fast_assign(
+        __entry->index = index;
+        __entry->temp_mC = temp_mC;
+        __entry->threshold_mC = threshold_mC;
+        __entry->rising = rising;
+    ),
+    TP_printk("simtemp%d temp=%u mC threshold=%u mC %s",
+        __entry->index, __entry->temp_mC, __entry->threshold_mC,
+        __entry->rising ? "rising" : "falling")
+);
+
+/* read() delivered `count` samples starting at sequence `tail` */
+TRACE_EVENT(sample_read,
+    TP_PROTO(int index, u64 tail, u32 count),
+    TP_ARGS(index, tail, count),
+    TP_STRUCT__entry(
+        __field(int, index)
+        __field(u64, tail)
+        __field(u32, count)
+    ),
+    TP_fast_assign(
+        __entry->index = index;
+        __entry->tail = tail;
+        __entry->count = count;
+    ),
+    TP_printk("simtemp%d tail=%llu count=%u",
+        __entry->index, __entry->tail, __entry->count)
+);
+
+/* A configuration field was updated */
+TRACE_EVENT(config_changed,
+    TP_PROTO(int index, u32 field, u64 value),
+    TP_ARGS(index, field, value),
+    TP_STRUCT__entry(
+        __field(int, index)
+        __field(u32, field)
+        __field(u64, value)
+    ),
+    TP_fast_assign(
+        __entry->index = index;
+        __entry->field = field;
+        __entry->value = value;
+    ),
+    TP_printk("simtemp%d %s=%llu",
+        __entry->index, show_simtemp_cfg(__entry->field), __entry->value)
+);
+
+#endif  // KERNEL_INCLUDE_NXP_SIMTEMP_TRACE_H_
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH include
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE nxp_simtemp_trace
+#include <trace/define_trace.h>
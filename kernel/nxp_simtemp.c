@@ -16,7 +16,17 @@
 #include <linux/sysfs.h>
 #include <linux/kernel.h>
 #include <linux/kobject.h>
+#include <linux/mutex.h>
 #include <linux/kfifo.h>
+#include <linux/average.h>          // For DECLARE_EWMA()
+#include <linux/idr.h>              // For struct ida
+#include <linux/rculist.h>          // For the RCU walk over open files
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#if defined(RBPITGT)
+#include <uapi/linux/sched/types.h> // For struct sched_param
+#endif
 #include <linux/poll.h>
 #include <linux/wait.h>
 #include <linux/uaccess.h>
@@ -25,19 +35,219 @@
 #include <linux/slab.h>             // For kzalloc()
 #include <linux/workqueue.h>        // For workqueue functions
 #include <linux/timekeeping.h>      // For ktime_get_ns()
-#include <linux/random.h>           // For get_random_u32()
+#include <linux/random.h>           // For get_random_u64(), prandom_u32_state()
 #include <linux/property.h>         // For struct property_entry
 #include <linux/hrtimer.h>
 #include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>          // For vmalloc_user()
+#include <linux/rwsem.h>
+#include <linux/log2.h>             // For roundup_pow_of_two()
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>   // For the per-CPU counters
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <net/genetlink.h>
+#if IS_REACHABLE(CONFIG_HWMON)
+#include <linux/hwmon.h>
+#endif
+#if IS_REACHABLE(CONFIG_IIO_TRIGGERED_BUFFER)
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#endif
 
 /* NXP defined structs */
 #include "include/nxp_simtemp.h"
 #include "include/nxp_simtemp_ioctl.h"
+#include "include/nxp_simtemp_netlink.h"
+
+#define CREATE_TRACE_POINTS
+#include "include/nxp_simtemp_trace.h"
 
 /**
  * @note **Version History:**
  *
  * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.25.0
+ * ### Enh
+ * - Per-device timestamp clock: realtime (default), monotonic,
+ *   monotonic-raw, boottime or tai, each also through its NMI-safe fast
+ *   accessor. Selected with the timestamp_clock attribute, the
+ *   'timestamp-clock' DT property or SIMTEMP_IOC_SET_CLOCK, reported with
+ *   its clock_gettime() id by SIMTEMP_IOC_GET_CLOCK.
+ * ### Fix
+ * - struct simtemp_sample documented its timestamp as monotonic, it is
+ *   CLOCK_REALTIME unless another clock is selected.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.24.0
+ * ### Enh
+ * - hwmon front-end: temp1_input, temp1_max (threshold_mC), temp1_max_hyst
+ *   (threshold_mC - hysteresis_mC) and temp1_max_alarm, read from the
+ *   producer state without consuming samples.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.23.0
+ * ### Enh
+ * - Industrial I/O front-end: every instance also registers an IIO device
+ *   with in_temp_raw/in_temp_scale and a triggered kfifo buffer of
+ *   temperature plus timestamp, when CONFIG_IIO_TRIGGERED_BUFFER is set.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.22.0
+ * ### Enh
+ * - Per-CPU u64_stats counters of dropped samples, reads, bytes read,
+ *   wakeups, polls, empty reads, timer overruns and config changes, read
+ *   through the 'counters' attribute and SIMTEMP_IOC_GET_COUNTERS.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.21.0
+ * ### Enh
+ * - Binary control surface: SIMTEMP_IOC_GET_CONFIG, SIMTEMP_IOC_SET_FIELDS,
+ *   SIMTEMP_IOC_GET_STATS, SIMTEMP_IOC_GET_LATEST and SIMTEMP_IOC_FLUSH.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.20.0
+ * ### Enh
+ * - Generic netlink family "simtemp" multicasting sample batches and alerts
+ *   to the "samples" and "alerts" groups.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.19.0
+ * ### Enh
+ * - read_iter and splice_read instead of read, for readv(), io_uring and
+ *   splice()/sendfile() of the sample stream.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.18.0
+ * ### Enh
+ * - Wakeup coalescing: per file low watermark and max latency deadline
+ *   (SIMTEMP_IOC_SET_WAKEUP). read() and poll() share one wait queue per file.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.17.0
+ * ### Enh
+ * - Threshold alerts with hysteresis (hysteresis_mC), raised on transitions
+ *   only and queued per device; SIMTEMP_IOC_GET_ALERT reads them without
+ *   consuming samples. POLLPRI now means unread alerts.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.16.0
+ * ### Enh
+ * - Windowed aggregation: min, max, mean, variance, EWMA and samples above
+ *   threshold per window_ms window, through the aggregate attribute and
+ *   SIMTEMP_IOC_GET_AGGREGATE.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.15.0
+ * ### Enh
+ * - Replay mode: records written to the device (legacy or compact format)
+ *   are played back with their original spacing, sped up by replay_speed.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.14.0
+ * ### Enh
+ * - Table driven temperature models: sine, sawtooth, step and noise modes
+ *   next to normal and ramp, fed by a seedable per device PRNG ('seed'
+ *   attribute and DT property) for reproducible runs.
+ * ### Fix
+ * - Division by zero when threshold_mC is 0.
+ * - SIMTEMP_IOC_SET_ALL accepted unknown modes.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.13.0
+ * ### Enh
+ * - Per file read() record format (SIMTEMP_IOC_SET_FORMAT): legacy 16 byte
+ *   samples (default), compact 8 byte records with delta timestamps and
+ *   periodic sync records, or raw 4 byte readings.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.12.0
+ * ### Enh
+ * - Runtime-sized sample history: 'fifo-depth' DT property, fifo_depth
+ *   module parameter, fifo_depth attribute and SIMTEMP_IOC_SET_FIFO_DEPTH.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.11.0
+ * ### Enh
+ * - Selectable overflow policy (drop-oldest, drop-newest, overwrite) through
+ *   the overflow_policy attribute and 'overflow-policy' DT property.
+ * - Exact drop counters in stats and a DATA_GAP sample flag after losses.
+ * - Ring header version 2 adds rewrite_seq for in-place rewrites.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.10.0
+ * ### Enh
+ * - Produce-to-deliver latency of every sample returned by read(), as
+ *   log2 histograms per device (debugfs 'latency') and per file
+ *   (SIMTEMP_IOC_GET_LATENCY), with percentile estimates.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.9.0
+ * ### Enh
+ * - Timer jitter diagnostics: log2 lateness histogram and missed period
+ *   counter in /sys/kernel/debug/simtemp/<name>/jitter, writing resets them.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.8.0
+ * ### Enh
+ * - Selectable sample generation context: hardirq hrtimer, softirq hrtimer
+ *   or a pinnable SCHED_FIFO kthread (gen_context/gen_cpu attributes and
+ *   'gen-context'/'gen-cpu' DT properties).
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.7.0
+ * ### Enh
+ * - Add sample_produced, sample_dropped, threshold_crossed, sample_read and
+ *   config_changed trace events.
+ * ### Fix
+ * - Remove printk from the sampling hot path, use the trace events instead.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.6.0
+ * ### Enh
+ * - Lockless single-producer sample path: the timer callback and poll() no
+ *   longer take the device lock, the sampling period is read through a
+ *   seqcount and wait queues are only touched when somebody waits.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.5.0
+ * ### Enh
+ * - Nanosecond sampling periods through sysfs (sampling_us, sampling_ns),
+ *   ioctl and the 'sampling-us' DT property. Periods below MIN_TIMER_NS
+ *   produce several timestamp-interpolated samples per timer expiry.
+ * ### Fix
+ * - Never cancel the timer while holding the lock its callback takes.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.4.0
+ * ### Enh
+ * - Support multiple instances, one per DT node or `nr_devices` software
+ *   devices, each with its own /dev/simtemp<N>, sysfs group, timer and
+ *   history.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.3.0
+ * ### Enh
+ * - Replace the shared destructive KFIFO with per-file read cursors over the
+ *   shared sample history, every reader sees the full stream.
+ * - Count overruns per reader, a slow reader only loses its own samples.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.2.0
+ * ### Enh
+ * - Publish samples into a shared ring that consumers can mmap() and drain
+ *   without read() syscalls. poll() honours the consumer's mapped tail.
+ *
+ * -----------------------------------------------------------------------------
+ * ## - 2026-10-16 - 1.1.0
+ * ### Enh
+ * - read() drains as many whole samples as fit in the user buffer.
+ *
+ * -----------------------------------------------------------------------------
  * ## - 2025-10-17 - 1.0.1
  * ### Fix
  * - Fix logging for kfifo full
@@ -80,490 +290,3828 @@
  *
  * -----------------------------------------------------------------------------
  */
-#define DRIVER_VERSION "1.0.1"
+#define DRIVER_VERSION "1.25.0"
 
-/* Device state holder */
-static struct simtemp_dev *simtemp_data;
+/* Allocates the N in /dev/simtemp<N> for every probed instance */
+static DEFINE_IDA(simtemp_ida);
 
-/* --- Sysfs Attributes --- */
-static ssize_t sampling_ms_show(struct device *dev,
-    struct device_attribute *attr, char *buf) {
-    struct simtemp_dev *sdev = dev->driver_data;
-    unsigned long flags;
-    u32 sampling_ms;
+/* Default ring depth for instances without a 'fifo-depth' property */
+static unsigned int fifo_depth = DEFAULT_RING_SIZE;
+module_param(fifo_depth, uint, 0444);
+MODULE_PARM_DESC(fifo_depth,
+    "Samples kept per device without a 'fifo-depth' property (default 256)");
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    sampling_ms = sdev->sampling_ms;
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+/* /sys/kernel/debug/simtemp, holds one directory per instance */
+static struct dentry *simtemp_debugfs_root;
+
+/* --- Sample generation, see simtemp_start_generator() --- */
+static int simtemp_start_generator(struct simtemp_dev *sdev);
+static void simtemp_stop_generator(struct simtemp_dev *sdev);
+
+/* --- IIO buffer feed, see simtemp_iio_work() --- */
+static bool simtemp_iio_buffering(struct simtemp_dev *sdev);
+static void simtemp_iio_work(struct work_struct *work);
+
+/**
+ * @brief Restart the sample generator with the current configuration.
+ * @param sdev Pointer to simtemp_dev.
+ * @return 0 on success, different than 0 otherwise.
+ */
+static int simtemp_restart_generator(struct simtemp_dev *sdev) {
+    int ret;
 
-    return scnprintf(buf, PAGE_SIZE, "%u\n", sampling_ms);
+    mutex_lock(&sdev->gen_lock);
+    simtemp_stop_generator(sdev);
+    ret = simtemp_start_generator(sdev);
+    mutex_unlock(&sdev->gen_lock);
+
+    return ret;
 }
 
-static ssize_t sampling_ms_store(struct device *dev,
-    struct device_attribute *attr, const char *buf, size_t count) {
-    struct simtemp_dev *sdev = dev->driver_data;
-    u32 val;
-    int err;
+/* --- Per-CPU counters --- */
+
+/**
+ * @brief Add to a per-CPU counter of a device.
+ * @param sdev Pointer to simtemp_dev.
+ * @param id SIMTEMP_STAT_* counter.
+ * @param val Amount to add.
+ * @note Callable from any context. Interrupts stay off while this CPU's
+ *       copy is updated, so the producer never interrupts a reader's update.
+ */
+static void simtemp_stat_add(struct simtemp_dev *sdev, enum simtemp_stat id,
+    u64 val) {
+    struct simtemp_pcpu_stats *stats;
     unsigned long flags;
 
-    err = kstrtou32(buf, 10, &val);
-    if (err) {
-        return err;
+    local_irq_save(flags);
+    stats = this_cpu_ptr(sdev->stats);
+    u64_stats_update_begin(&stats->syncp);
+    stats->cnt[id] += val;
+    u64_stats_update_end(&stats->syncp);
+    local_irq_restore(flags);
+}
+
+/**
+ * @brief Sum the per-CPU counters of a device.
+ * @param sdev Pointer to simtemp_dev.
+ * @param counters Pointer to the simtemp_counters to fill.
+ */
+static void simtemp_get_counters(struct simtemp_dev *sdev,
+    struct simtemp_counters *counters) {
+    const struct simtemp_pcpu_stats *stats;
+    u64 sum[SIMTEMP_STAT_NR] = { 0 };
+    u64 snap[SIMTEMP_STAT_NR];
+    unsigned int start;
+    int cpu, i;
+
+    for_each_possible_cpu(cpu) {
+        stats = per_cpu_ptr(sdev->stats, cpu);
+        do {
+            start = u64_stats_fetch_begin(&stats->syncp);
+            memcpy(snap, stats->cnt, sizeof(snap));
+        } while (u64_stats_fetch_retry(&stats->syncp, start));
+
+        for (i = 0; i < SIMTEMP_STAT_NR; i++) {
+            sum[i] += snap[i];
+        }
+    }
+
+    memset(counters, 0, sizeof(*counters));
+    counters->version = SIMTEMP_COUNTERS_VERSION;
+    counters->samples_dropped = sum[SIMTEMP_STAT_SAMPLES_DROPPED];
+    counters->reads = sum[SIMTEMP_STAT_READS];
+    counters->bytes_read = sum[SIMTEMP_STAT_BYTES_READ];
+    counters->wakeups = sum[SIMTEMP_STAT_WAKEUPS];
+    counters->polls = sum[SIMTEMP_STAT_POLLS];
+    counters->empty_reads = sum[SIMTEMP_STAT_EMPTY_READS];
+    counters->timer_overruns = sum[SIMTEMP_STAT_TIMER_OVERRUNS];
+    counters->config_changes = sum[SIMTEMP_STAT_CONFIG_CHANGES];
+}
+
+/**
+ * @brief Count a configuration update and trace it.
+ * @param sdev Pointer to simtemp_dev.
+ * @param field SIMTEMP_CFG_* field that changed.
+ * @param value New value of the field.
+ */
+static void simtemp_config_changed(struct simtemp_dev *sdev,
+    enum simtemp_cfg_field field, u64 value) {
+    simtemp_stat_add(sdev, SIMTEMP_STAT_CONFIG_CHANGES, 1);
+    trace_config_changed(sdev->index, field, value);
+
+    if (field != SIMTEMP_CFG_MODE || !wq_has_sleeper(&sdev->replay_wait)) {
+        return;
+    }
+    if (value == MODE_REPLAY) {
+        /* Replay writers polling for POLLOUT can only get it from now on */
+        wake_up_interruptible_poll(&sdev->replay_wait, POLLOUT | POLLWRNORM);
+    } else {
+        /* Nothing drains the queue anymore, blocked writers give up */
+        wake_up_interruptible(&sdev->replay_wait);
     }
-    if (val < MIN_SAMPLE_MS) { /* Minimum MIN_SAMPLE_MS for stability */
+}
+
+/* --- Sampling period --- */
+
+/**
+ * @brief Apply a new sampling period and restart the timer.
+ * @param sdev Pointer to simtemp_dev.
+ * @param sampling_ns Sampling period in nanoseconds.
+ * @return 0 on success, -EINVAL if the period is out of range.
+ *
+ * Periods shorter than MIN_TIMER_NS are served by firing the timer every
+ * samples_per_tick periods and producing that many samples per expiry.
+ */
+static int simtemp_set_period(struct simtemp_dev *sdev, u64 sampling_ns) {
+    unsigned long flags;
+    u32 samples_per_tick;
+    ktime_t tick_period;
+
+    if (sampling_ns < MIN_SAMPLE_NS || sampling_ns > MAX_SAMPLE_NS) {
         return -EINVAL;
     }
 
-    /* START CRITICAL BLOCK */
+    samples_per_tick = 1;
+    if (sampling_ns < MIN_TIMER_NS) {
+        samples_per_tick = DIV_ROUND_UP_ULL(MIN_TIMER_NS, sampling_ns);
+    }
+    tick_period = ns_to_ktime(sampling_ns * samples_per_tick);
+
+    /*
+     * START CRITICAL BLOCK
+     * The timer reads the period locklessly, keep irqs off so it can't
+     * spin on an interrupted update on this CPU.
+     */
     spin_lock_irqsave(&sdev->lock, flags);
-    sdev->sampling_ms = val;
-    hrtimer_cancel(&sdev->temp_hrtimer);
-    hrtimer_start(&sdev->temp_hrtimer, ms_to_ktime(sdev->sampling_ms),
-        HRTIMER_MODE_REL);
+    write_seqcount_begin(&sdev->period_seq);
+    sdev->sampling_ns = sampling_ns;
+    sdev->samples_per_tick = samples_per_tick;
+    sdev->tick_period = tick_period;
+    write_seqcount_end(&sdev->period_seq);
     spin_unlock_irqrestore(&sdev->lock, flags);
     /* END CRITICAL BLOCK */
+    simtemp_config_changed(sdev, SIMTEMP_CFG_SAMPLING_NS, sampling_ns);
 
-    return count;
+    /* Stopping may wait for a running generator, keep it unlocked */
+    return simtemp_restart_generator(sdev);
 }
-static DEVICE_ATTR_RW(sampling_ms);
 
-static ssize_t threshold_mC_show(struct device *dev,
-    struct device_attribute *attr, char *buf) {
-    struct simtemp_dev *sdev = dev->driver_data;
-    u32 threshold_mC;
-    unsigned long flags;
+/* --- Sample history --- */
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    threshold_mC = sdev->threshold_mC;
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+/**
+ * @brief Allocate a ring with its header page, mappable to user space.
+ * @param depth Number of sample slots, power of 2.
+ * @return Pointer to the ring header, NULL on failure.
+ */
+static struct simtemp_ring_header *simtemp_ring_alloc(u32 depth) {
+    struct simtemp_ring_header *ring;
 
-    return scnprintf(buf, PAGE_SIZE, "%u\n", threshold_mC);
+    ring = vmalloc_user(PAGE_SIZE +
+        PAGE_ALIGN((size_t)depth * sizeof(struct simtemp_sample)));
+    if (!ring) {
+        return NULL;
+    }
+    ring->version = SIMTEMP_RING_VERSION;
+    ring->size = depth;
+    ring->data_offset = PAGE_SIZE;
+    ring->sample_size = sizeof(struct simtemp_sample);
+
+    return ring;
 }
 
-static ssize_t threshold_mC_store(struct device *dev,
-    struct device_attribute *attr, const char *buf, size_t count) {
-    struct simtemp_dev *sdev = dev->driver_data;
-    u32 val;
-    int err;
-    unsigned long flags;
+/**
+ * @brief Validate a requested ring depth.
+ * @param depth Requested number of samples.
+ * @return Depth rounded up to a power of 2, 0 if out of range.
+ */
+static u32 simtemp_ring_depth(u32 depth) {
+    if (depth < MIN_RING_SIZE || depth > MAX_RING_SIZE) {
+        return 0;
+    }
 
-    err = kstrtos32(buf, 10, &val);
-    if (err) {
-        return err;
+    return roundup_pow_of_two(depth);
+}
+
+/**
+ * @brief Replace the shared history with one of a different depth.
+ * @param sdev Pointer to simtemp_dev.
+ * @param depth Requested number of samples.
+ * @return 0 on success, -EBUSY if the ring is mapped, different than 0
+ *         otherwise.
+ * @note The newest samples and every sequence number survive the resize,
+ *       readers only lose what no longer fits.
+ */
+static int simtemp_resize_ring(struct simtemp_dev *sdev, u32 depth) {
+    struct simtemp_ring_header *ring, *old;
+    struct simtemp_sample *data;
+    u32 old_mask, new_mask;
+    u64 head, seq, keep;
+    int ret = 0;
+
+    depth = simtemp_ring_depth(depth);
+    if (!depth) {
+        return -EINVAL;
     }
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    sdev->threshold_mC = val;
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+    ring = simtemp_ring_alloc(depth);
+    if (!ring) {
+        return -ENOMEM;
+    }
+    data = (void *)ring + PAGE_SIZE;
 
-    return count;
+    /* Wait for read() callers to leave the ring, then stop the producer */
+    mutex_lock(&sdev->gen_lock);
+    down_write(&sdev->ring_rwsem);
+    if (atomic_read(&sdev->ring_mappers)) {
+        up_write(&sdev->ring_rwsem);
+        mutex_unlock(&sdev->gen_lock);
+        vfree(ring);
+        return -EBUSY;
+    }
+    simtemp_stop_generator(sdev);
+
+    old = sdev->ring;
+    old_mask = sdev->ring_size - 1;
+    new_mask = depth - 1;
+    head = old->head;
+    keep = min3(head, (u64)old_mask, (u64)new_mask);
+    for (seq = head - keep; seq != head; seq++) {
+        data[seq & new_mask] = sdev->ring_data[seq & old_mask];
+    }
+    ring->head = head;
+    ring->rewrite_seq = old->rewrite_seq;
+
+    sdev->ring = ring;
+    sdev->ring_data = data;
+    WRITE_ONCE(sdev->ring_size, depth);
+    up_write(&sdev->ring_rwsem);
+    simtemp_config_changed(sdev, SIMTEMP_CFG_FIFO_DEPTH, depth);
+
+    ret = simtemp_start_generator(sdev);
+    mutex_unlock(&sdev->gen_lock);
+    vfree(old);
+
+    dev_info(sdev->dev, "Sample history resized to %u samples\n", depth);
+    return ret;
 }
-static DEVICE_ATTR_RW(threshold_mC);
 
-static ssize_t mode_show(struct device *dev, struct device_attribute *attr,
-    char *buf) {
-    struct simtemp_dev *sdev = dev->driver_data;
-    unsigned long flags;
-    const char *mode_str;
-    u32 mode;
+/* --- Waveform generator --- */
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    mode = simtemp_data->mode;
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+/* First quarter of a sine period in Q15, the rest is mirrored */
+static const s16 sine_q15[WAVE_STEPS / 4 + 1] = {
+        0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+     6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767,
+};
 
-    switch (mode) {
-        case MODE_NORMAL:
-            mode_str = "normal";
-            break;
-        case MODE_RAMP:
-            mode_str = "ramp";
-            break;
+/**
+ * @brief Look up the sine of a waveform position.
+ * @param phase Position in the period, 0..WAVE_STEPS - 1.
+ * @return Sine in Q15.
+ */
+static s32 simtemp_sine(u32 phase) {
+    const u32 quarter = WAVE_STEPS / 4;
+    u32 i = phase % quarter;
+
+    switch (phase / quarter) {
+        case 0:
+            return sine_q15[i];
+        case 1:
+            return sine_q15[quarter - i];
+        case 2:
+            return -sine_q15[i];
         default:
-            mode_str = "unknown";
-            break;
+            return -sine_q15[quarter - i];
     }
+}
 
-    return scnprintf(buf, PAGE_SIZE, "%s\n", mode_str);
+/**
+ * @brief Uniform random value without a division.
+ * @param sdev Pointer to simtemp_dev.
+ * @param range Number of values, 0 yields 0.
+ * @return Value in [0, range).
+ */
+static u32 simtemp_random(struct simtemp_dev *sdev, u32 range) {
+    return reciprocal_scale(prandom_u32_state(&sdev->rng), range);
 }
 
-static ssize_t mode_store(struct device *dev, struct device_attribute *attr,
-    const char *buf, size_t count) {
-    struct simtemp_dev *sdev = dev->driver_data;
-    unsigned long flags;
-    u32 new_mode;
+static u32 model_normal(struct simtemp_dev *sdev, u32 threshold_mC) {
+    return simtemp_random(sdev, threshold_mC);
+}
 
-    if (sysfs_streq(buf, "normal")) {
-        new_mode = MODE_NORMAL;
-    } else if (sysfs_streq(buf, "ramp")) {
-        new_mode = MODE_RAMP;
-    } else {
-        return -EINVAL;
+static u32 model_ramp(struct simtemp_dev *sdev, u32 threshold_mC) {
+    u32 temp = simtemp_random(sdev, threshold_mC);
+
+    /* Simulate a threshold crossed read every MAX_COUNT samples */
+    sdev->counter += 1;
+    if (sdev->counter > RAMP_START) {
+        temp = threshold_mC + sdev->counter;
+        if (sdev->counter >= RAMP_STOP) {
+            sdev->counter = 0;
+        }
     }
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    simtemp_data->mode = new_mode;
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+    return temp;
+}
 
-    return count;
+static u32 model_sine(struct simtemp_dev *sdev, u32 threshold_mC) {
+    return clamp_t(s64, (s64)threshold_mC +
+        ((s64)WAVE_AMPLITUDE_MC * simtemp_sine(sdev->phase) >> 15),
+        0, U32_MAX);
 }
-static DEVICE_ATTR_RW(mode);
 
-static ssize_t stats_show(struct device *dev, struct device_attribute *attr,
-    char *buf) {
-    struct simtemp_dev *sdev = dev->driver_data;
-    u64 samples_taken, threshold_alerts;
-    unsigned long flags;
+static u32 model_sawtooth(struct simtemp_dev *sdev, u32 threshold_mC) {
+    return clamp_t(s64, (s64)threshold_mC - WAVE_AMPLITUDE_MC +
+        2 * WAVE_AMPLITUDE_MC * sdev->phase / WAVE_STEPS, 0, U32_MAX);
+}
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    samples_taken = sdev->samples_taken;
-    threshold_alerts = sdev->threshold_alerts;
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+static u32 model_step(struct simtemp_dev *sdev, u32 threshold_mC) {
+    if (sdev->phase < WAVE_STEPS / 2) {
+        return clamp_t(s64, (s64)threshold_mC - WAVE_AMPLITUDE_MC, 0,
+            U32_MAX);
+    }
+
+    return clamp_t(s64, (s64)threshold_mC + WAVE_AMPLITUDE_MC, 0, U32_MAX);
+}
+
+static u32 model_noise(struct simtemp_dev *sdev, u32 threshold_mC) {
+    return clamp_t(s64, (s64)threshold_mC - WAVE_AMPLITUDE_MC - NOISE_MC +
+        simtemp_random(sdev, 2 * NOISE_MC + 1), 0, U32_MAX);
+}
+
+static u32 model_replay(struct simtemp_dev *sdev, u32 threshold_mC) {
+    /* Samples come from simtemp_replay_tick(), hold the last one */
+    return sdev->current_temp;
+}
+
+/*
+ * Temperature models selectable through the mode attribute, indexed by
+ * MODE_*. Every model only runs in the producer and keeps its state in
+ * simtemp_dev.
+ */
+static const struct {
+    const char *name;
+    u32 (*next)(struct simtemp_dev *sdev, u32 threshold_mC);
+} simtemp_models[] = {
+    [MODE_NORMAL] = { "normal", model_normal },
+    [MODE_RAMP] = { "ramp", model_ramp },
+    [MODE_SINE] = { "sine", model_sine },
+    [MODE_SAWTOOTH] = { "sawtooth", model_sawtooth },
+    [MODE_STEP] = { "step", model_step },
+    [MODE_NOISE] = { "noise", model_noise },
+    [MODE_REPLAY] = { "replay", model_replay },
+};
+
+/**
+ * @brief Restart the generator PRNG and waveforms from a seed.
+ * @param sdev Pointer to simtemp_dev.
+ * @param seed PRNG seed.
+ * @note Producer only, other contexts request it through sdev->reseed.
+ */
+static void simtemp_seed(struct simtemp_dev *sdev, u64 seed) {
+    prandom_seed_state(&sdev->rng, seed);
+    sdev->phase = 0;
+    sdev->counter = 0;
+}
+
+/**
+ * @brief Get the next simulated temperature from the selected model.
+ * @param sdev Pointer to simtemp_dev.
+ * @return Temperature in milli-degree Celsius.
+ */
+static u32 get_temperature(struct simtemp_dev *sdev) {
+    u32 mode = READ_ONCE(sdev->mode);
+    u32 temp;
+
+    if (READ_ONCE(sdev->reseed)) {
+        simtemp_seed(sdev, READ_ONCE(sdev->seed));
+        WRITE_ONCE(sdev->reseed, false);
+    }
+
+    if (mode >= ARRAY_SIZE(simtemp_models)) {
+        mode = MODE_NORMAL;
+    }
+    temp = simtemp_models[mode].next(sdev, READ_ONCE(sdev->threshold_mC));
+    sdev->phase = (sdev->phase + 1) % WAVE_STEPS;
+
+    return temp;
+}
+
+/* --- Windowed aggregation --- */
+
+/**
+ * @brief Account a sample in the rolling statistics.
+ * @param sdev Pointer to simtemp_dev.
+ * @param sample Published sample.
+ * @note Producer only. Windows are back to back, the first sample past the
+ *       end of a window completes it and starts the next one.
+ */
+static void simtemp_aggregate(struct simtemp_dev *sdev,
+    const struct simtemp_sample *sample) {
+    struct simtemp_window *win = &sdev->win_cur;
+    u64 window_ns = (u64)READ_ONCE(sdev->window_ms) * NSEC_PER_MSEC;
+    s64 d;
+
+    /* seqcount writers must not be preempted, the kthread context could be */
+    preempt_disable();
+    write_seqcount_begin(&sdev->agg_seq);
+
+    if (win->count && (sample->timestamp_ns < win->start_ns ||
+        sample->timestamp_ns - win->start_ns >= window_ns)) {
+        sdev->win_last = *win;
+        win->count = 0;
+    }
+    if (!win->count) {
+        memset(win, 0, sizeof(*win));
+        win->start_ns = sample->timestamp_ns;
+        win->min_mC = U32_MAX;
+        win->base_mC = sample->temp_mC;
+    }
+
+    d = (s64)sample->temp_mC - win->base_mC;
+    win->end_ns = sample->timestamp_ns;
+    win->count++;
+    win->sum += d;
+    win->sum_sq += d * d;
+    win->min_mC = min(win->min_mC, sample->temp_mC);
+    win->max_mC = max(win->max_mC, sample->temp_mC);
+    if (sample->temp_mC >= READ_ONCE(sdev->threshold_mC)) {
+        win->above++;
+    }
+    ewma_simtemp_temp_add(&sdev->ewma, sample->temp_mC);
+    win->ewma_mC = ewma_simtemp_temp_read(&sdev->ewma);
+
+    write_seqcount_end(&sdev->agg_seq);
+    preempt_enable();
+}
+
+/**
+ * @brief Summarize a window for user space.
+ * @param win Pointer to a stable simtemp_window.
+ * @param stats Pointer to the simtemp_window_stats to fill.
+ */
+static void simtemp_window_to_stats(const struct simtemp_window *win,
+    struct simtemp_window_stats *stats) {
+    s64 mean_d;
+    u64 mean_sq;
+
+    memset(stats, 0, sizeof(*stats));
+    if (!win->count) {
+        return;
+    }
+
+    mean_d = div_s64(win->sum, win->count);
+    mean_sq = div_u64(win->sum_sq, win->count);
+    stats->start_ns = win->start_ns;
+    stats->end_ns = win->end_ns;
+    stats->count = win->count;
+    stats->above = win->above;
+    stats->min_mC = win->min_mC;
+    stats->max_mC = win->max_mC;
+    stats->mean_mC = win->base_mC + mean_d;
+    stats->variance_mC2 = mean_sq > (u64)(mean_d * mean_d) ?
+        mean_sq - mean_d * mean_d : 0;
+    stats->ewma_mC = win->ewma_mC;
+}
+
+/**
+ * @brief Take a consistent snapshot of the rolling statistics.
+ * @param sdev Pointer to simtemp_dev.
+ * @param agg Pointer to the simtemp_aggregate to fill.
+ */
+static void simtemp_get_aggregate(struct simtemp_dev *sdev,
+    struct simtemp_aggregate *agg) {
+    struct simtemp_window cur, last;
+    unsigned long ewma;
+    unsigned int seq;
+
+    do {
+        seq = read_seqcount_begin(&sdev->agg_seq);
+        cur = sdev->win_cur;
+        last = sdev->win_last;
+        ewma = ewma_simtemp_temp_read(&sdev->ewma);
+    } while (read_seqcount_retry(&sdev->agg_seq, seq));
+
+    memset(agg, 0, sizeof(*agg));
+    agg->window_ms = READ_ONCE(sdev->window_ms);
+    agg->ewma_mC = ewma;
+    simtemp_window_to_stats(&last, &agg->last);
+    simtemp_window_to_stats(&cur, &agg->current);
+}
+
+/* --- Sysfs Attributes --- */
+static ssize_t simtemp_period_show(struct device *dev, char *buf, u64 unit_ns) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u64 sampling_ns;
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    sampling_ns = sdev->sampling_ns;
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", div64_u64(sampling_ns, unit_ns));
+}
+
+static ssize_t simtemp_period_store(struct device *dev, const char *buf,
+    size_t count, u64 unit_ns) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u64 val;
+    int err;
+
+    err = kstrtou64(buf, 10, &val);
+    if (err) {
+        return err;
+    }
+    if (val > div64_u64(MAX_SAMPLE_NS, unit_ns)) {
+        return -EINVAL;
+    }
+
+    err = simtemp_set_period(sdev, val * unit_ns);
+    if (err) {
+        return err;
+    }
+
+    return count;
+}
+
+static ssize_t sampling_ms_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    return simtemp_period_show(dev, buf, NSEC_PER_MSEC);
+}
+
+static ssize_t sampling_ms_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    return simtemp_period_store(dev, buf, count, NSEC_PER_MSEC);
+}
+static DEVICE_ATTR_RW(sampling_ms);
+
+static ssize_t sampling_us_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    return simtemp_period_show(dev, buf, NSEC_PER_USEC);
+}
+
+static ssize_t sampling_us_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    return simtemp_period_store(dev, buf, count, NSEC_PER_USEC);
+}
+static DEVICE_ATTR_RW(sampling_us);
+
+static ssize_t sampling_ns_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    return simtemp_period_show(dev, buf, 1);
+}
+
+static ssize_t sampling_ns_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    return simtemp_period_store(dev, buf, count, 1);
+}
+static DEVICE_ATTR_RW(sampling_ns);
+
+static ssize_t threshold_mC_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u32 threshold_mC;
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    threshold_mC = sdev->threshold_mC;
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", threshold_mC);
+}
+
+static ssize_t threshold_mC_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u32 val;
+    int err;
+
+    err = kstrtos32(buf, 10, &val);
+    if (err) {
+        return err;
+    }
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    WRITE_ONCE(sdev->threshold_mC, val);
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+    simtemp_config_changed(sdev, SIMTEMP_CFG_THRESHOLD_MC, val);
+
+    return count;
+}
+static DEVICE_ATTR_RW(threshold_mC);
+
+static ssize_t hysteresis_mC_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(sdev->hysteresis_mC));
+}
+
+static ssize_t hysteresis_mC_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u32 val;
+    int err;
+
+    err = kstrtou32(buf, 10, &val);
+    if (err) {
+        return err;
+    }
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    WRITE_ONCE(sdev->hysteresis_mC, val);
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+    simtemp_config_changed(sdev, SIMTEMP_CFG_HYSTERESIS_MC, val);
+
+    return count;
+}
+static DEVICE_ATTR_RW(hysteresis_mC);
+
+static ssize_t mode_show(struct device *dev, struct device_attribute *attr,
+    char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    const char *mode_str = "unknown";
+    u32 mode;
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    mode = sdev->mode;
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+
+    if (mode < ARRAY_SIZE(simtemp_models)) {
+        mode_str = simtemp_models[mode].name;
+    }
+
+    return scnprintf(buf, PAGE_SIZE, "%s\n", mode_str);
+}
+
+static ssize_t mode_store(struct device *dev, struct device_attribute *attr,
+    const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u32 new_mode;
+
+    for (new_mode = 0; new_mode < ARRAY_SIZE(simtemp_models); new_mode++) {
+        if (sysfs_streq(buf, simtemp_models[new_mode].name)) {
+            break;
+        }
+    }
+    if (new_mode == ARRAY_SIZE(simtemp_models)) {
+        return -EINVAL;
+    }
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    WRITE_ONCE(sdev->mode, new_mode);
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+    simtemp_config_changed(sdev, SIMTEMP_CFG_MODE, new_mode);
+
+    return count;
+}
+static DEVICE_ATTR_RW(mode);
+
+static ssize_t seed_show(struct device *dev, struct device_attribute *attr,
+    char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(sdev->seed));
+}
+
+static ssize_t seed_store(struct device *dev, struct device_attribute *attr,
+    const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u64 seed;
+    int err;
+
+    err = kstrtou64(buf, 0, &seed);
+    if (err) {
+        return err;
+    }
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    WRITE_ONCE(sdev->seed, seed);
+    /* The producer restarts the models before its next sample */
+    WRITE_ONCE(sdev->reseed, true);
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+    simtemp_config_changed(sdev, SIMTEMP_CFG_SEED, seed);
+
+    return count;
+}
+static DEVICE_ATTR_RW(seed);
+
+static ssize_t fifo_depth_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(sdev->ring_size));
+}
+
+static ssize_t fifo_depth_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u32 depth;
+    int err;
+
+    err = kstrtou32(buf, 10, &depth);
+    if (err) {
+        return err;
+    }
+
+    err = simtemp_resize_ring(sdev, depth);
+    if (err) {
+        return err;
+    }
+
+    return count;
+}
+static DEVICE_ATTR_RW(fifo_depth);
+
+static ssize_t window_ms_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(sdev->window_ms));
+}
+
+static ssize_t window_ms_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u32 window_ms;
+    int err;
+
+    err = kstrtou32(buf, 10, &window_ms);
+    if (err) {
+        return err;
+    }
+    if (window_ms < MIN_WINDOW_MS || window_ms > MAX_WINDOW_MS) {
+        return -EINVAL;
+    }
+
+    /* Applies from the next window on */
+    WRITE_ONCE(sdev->window_ms, window_ms);
+    simtemp_config_changed(sdev, SIMTEMP_CFG_WINDOW_MS, window_ms);
+
+    return count;
+}
+static DEVICE_ATTR_RW(window_ms);
+
+static ssize_t aggregate_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    struct simtemp_aggregate agg;
+
+    simtemp_get_aggregate(sdev, &agg);
+
+    /* Last completed window, the one dashboards want once per window */
+    return scnprintf(buf, PAGE_SIZE, "window_ms: %u\ncount: %u\nmin_mC: %u\n"
+        "max_mC: %u\nmean_mC: %u\nvariance_mC2: %llu\newma_mC: %u\n"
+        "above_threshold: %u\n", agg.window_ms, agg.last.count,
+        agg.last.min_mC, agg.last.max_mC, agg.last.mean_mC,
+        agg.last.variance_mC2, agg.last.ewma_mC, agg.last.above);
+}
+static DEVICE_ATTR_RO(aggregate);
+
+static ssize_t replay_speed_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(sdev->replay_speed));
+}
+
+static ssize_t replay_speed_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u32 speed;
+    int err;
+
+    err = kstrtou32(buf, 10, &speed);
+    if (err) {
+        return err;
+    }
+
+    WRITE_ONCE(sdev->replay_speed, speed);
+    simtemp_config_changed(sdev, SIMTEMP_CFG_REPLAY_SPEED, speed);
+
+    return count;
+}
+static DEVICE_ATTR_RW(replay_speed);
+
+static const char * const overflow_policy_names[] = {
+    [OVERFLOW_DROP_OLDEST] = "drop-oldest",
+    [OVERFLOW_DROP_NEWEST] = "drop-newest",
+    [OVERFLOW_OVERWRITE] = "overwrite",
+};
+
+static ssize_t overflow_policy_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%s\n",
+        overflow_policy_names[READ_ONCE(sdev->overflow_policy)]);
+}
+
+static ssize_t overflow_policy_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    int policy;
+
+    policy = sysfs_match_string(overflow_policy_names, buf);
+    if (policy < 0) {
+        return policy;
+    }
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    WRITE_ONCE(sdev->overflow_policy, policy);
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+    simtemp_config_changed(sdev, SIMTEMP_CFG_OVERFLOW_POLICY, policy);
+
+    return count;
+}
+static DEVICE_ATTR_RW(overflow_policy);
+
+static const char * const clock_names[] = {
+    [TSCLK_REALTIME] = "realtime",
+    [TSCLK_MONOTONIC] = "monotonic",
+    [TSCLK_MONOTONIC_RAW] = "monotonic-raw",
+    [TSCLK_BOOTTIME] = "boottime",
+    [TSCLK_TAI] = "tai",
+    [TSCLK_REALTIME_FAST] = "realtime-fast",
+    [TSCLK_MONOTONIC_FAST] = "monotonic-fast",
+    [TSCLK_MONOTONIC_RAW_FAST] = "monotonic-raw-fast",
+    [TSCLK_BOOTTIME_FAST] = "boottime-fast",
+    [TSCLK_TAI_FAST] = "tai-fast",
+};
+
+/* clock_gettime() id of every TSCLK_*, the fast ones read the same clock */
+static const clockid_t clock_ids[] = {
+    [TSCLK_REALTIME] = CLOCK_REALTIME,
+    [TSCLK_MONOTONIC] = CLOCK_MONOTONIC,
+    [TSCLK_MONOTONIC_RAW] = CLOCK_MONOTONIC_RAW,
+    [TSCLK_BOOTTIME] = CLOCK_BOOTTIME,
+    [TSCLK_TAI] = CLOCK_TAI,
+    [TSCLK_REALTIME_FAST] = CLOCK_REALTIME,
+    [TSCLK_MONOTONIC_FAST] = CLOCK_MONOTONIC,
+    [TSCLK_MONOTONIC_RAW_FAST] = CLOCK_MONOTONIC_RAW,
+    [TSCLK_BOOTTIME_FAST] = CLOCK_BOOTTIME,
+    [TSCLK_TAI_FAST] = CLOCK_TAI,
+};
+
+/**
+ * @brief Read the timestamp clock of a device.
+ * @param sdev Pointer to simtemp_dev.
+ * @return Current time of the selected clock in nanoseconds.
+ * @note The fast accessors never take the timekeeping seqlock, so they are
+ *       safe from any context, but may lag by a tick across an update.
+ */
+static u64 simtemp_clock_ns(struct simtemp_dev *sdev) {
+    switch (READ_ONCE(sdev->clock)) {
+        case TSCLK_MONOTONIC:
+            return ktime_get_ns();
+        case TSCLK_MONOTONIC_RAW:
+            return ktime_get_raw_ns();
+        case TSCLK_BOOTTIME:
+            return ktime_get_boottime_ns();
+        case TSCLK_TAI:
+            return ktime_get_clocktai_ns();
+        case TSCLK_REALTIME_FAST:
+            return ktime_get_real_fast_ns();
+        case TSCLK_MONOTONIC_FAST:
+            return ktime_get_mono_fast_ns();
+        case TSCLK_MONOTONIC_RAW_FAST:
+            return ktime_get_raw_fast_ns();
+        case TSCLK_BOOTTIME_FAST:
+            return ktime_get_boot_fast_ns();
+        case TSCLK_TAI_FAST:
+#if defined(RBPITGT)
+            /* No ktime_get_tai_fast_ns() before 5.19 */
+            return ktime_get_clocktai_ns();
+#else
+            return ktime_get_tai_fast_ns();
+#endif
+        default:
+            return ktime_get_real_ns();
+    }
+}
+
+/**
+ * @brief Select the clock the next samples are stamped with.
+ * @param sdev Pointer to simtemp_dev.
+ * @param clock New TSCLK_* clock.
+ * @return 0 on success, -EINVAL for an unknown clock.
+ * @note Timestamps jump when the clock changes, windows and compact sync
+ *       records already restart on a timestamp going backwards.
+ */
+static int simtemp_set_clock(struct simtemp_dev *sdev, u32 clock) {
+    if (clock >= ARRAY_SIZE(clock_names)) {
+        return -EINVAL;
+    }
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    WRITE_ONCE(sdev->clock, clock);
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+    simtemp_config_changed(sdev, SIMTEMP_CFG_CLOCK, clock);
+
+    return 0;
+}
+
+static ssize_t timestamp_clock_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%s\n",
+        clock_names[READ_ONCE(sdev->clock)]);
+}
+
+static ssize_t timestamp_clock_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    int clock;
+
+    clock = sysfs_match_string(clock_names, buf);
+    if (clock < 0) {
+        return clock;
+    }
+
+    simtemp_set_clock(sdev, clock);
+
+    return count;
+}
+static DEVICE_ATTR_RW(timestamp_clock);
+
+static const char * const gen_context_names[] = {
+    [GEN_CTX_HARDIRQ] = "hardirq",
+    [GEN_CTX_SOFTIRQ] = "softirq",
+    [GEN_CTX_KTHREAD] = "kthread",
+};
+
+/**
+ * @brief Move sample generation to another execution context.
+ * @param sdev Pointer to simtemp_dev.
+ * @param gen_context New GEN_CTX_* context.
+ * @param gen_cpu CPU the kthread is bound to, -1 for any.
+ * @return 0 on success, different than 0 otherwise.
+ */
+static int simtemp_set_gen_context(struct simtemp_dev *sdev, u32 gen_context,
+    int gen_cpu) {
+    u32 old_context;
+    int old_cpu;
+    int ret;
+
+    mutex_lock(&sdev->gen_lock);
+    old_context = sdev->gen_context;
+    old_cpu = sdev->gen_cpu;
+    simtemp_stop_generator(sdev);
+
+    sdev->gen_context = gen_context;
+    sdev->gen_cpu = gen_cpu;
+    ret = simtemp_start_generator(sdev);
+    if (ret) {
+        /* Keep sampling in the previous context */
+        sdev->gen_context = old_context;
+        sdev->gen_cpu = old_cpu;
+        simtemp_start_generator(sdev);
+    } else {
+        if (gen_context != old_context) {
+            simtemp_config_changed(sdev, SIMTEMP_CFG_GEN_CONTEXT,
+                gen_context);
+        }
+        if (gen_cpu != old_cpu) {
+            simtemp_config_changed(sdev, SIMTEMP_CFG_GEN_CPU, (u32)gen_cpu);
+        }
+    }
+    mutex_unlock(&sdev->gen_lock);
+
+    return ret;
+}
+
+static ssize_t gen_context_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%s\n",
+        gen_context_names[READ_ONCE(sdev->gen_context)]);
+}
+
+static ssize_t gen_context_store(struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    int ctx;
+    int err;
+
+    ctx = sysfs_match_string(gen_context_names, buf);
+    if (ctx < 0) {
+        return ctx;
+    }
+
+    err = simtemp_set_gen_context(sdev, ctx, READ_ONCE(sdev->gen_cpu));
+    if (err) {
+        return err;
+    }
+
+    return count;
+}
+static DEVICE_ATTR_RW(gen_context);
+
+static ssize_t gen_cpu_show(struct device *dev, struct device_attribute *attr,
+    char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+
+    return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(sdev->gen_cpu));
+}
+
+static ssize_t gen_cpu_store(struct device *dev, struct device_attribute *attr,
+    const char *buf, size_t count) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    int cpu;
+    int err;
+
+    err = kstrtoint(buf, 10, &cpu);
+    if (err) {
+        return err;
+    }
+    if (cpu < -1 || (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_online(cpu)))) {
+        return -EINVAL;
+    }
+
+    err = simtemp_set_gen_context(sdev, READ_ONCE(sdev->gen_context), cpu);
+    if (err) {
+        return err;
+    }
+
+    return count;
+}
+static DEVICE_ATTR_RW(gen_cpu);
+
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr,
+    char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    u64 samples_taken, threshold_alerts, dropped_newest, overwritten, replayed;
+
+    /* Written by the producer only */
+    samples_taken = READ_ONCE(sdev->samples_taken);
+    threshold_alerts = READ_ONCE(sdev->threshold_alerts);
+    dropped_newest = READ_ONCE(sdev->dropped_newest);
+    overwritten = READ_ONCE(sdev->overwritten);
+    replayed = READ_ONCE(sdev->replayed);
+
+    return scnprintf(buf, PAGE_SIZE, "samples_taken: %llu\nthreshold_alerts:"
+        " %llu\ndropped_oldest: %lld\ndropped_newest: %llu\noverwritten:"
+        " %llu\nreplayed: %llu\n", samples_taken, threshold_alerts,
+        atomic64_read(&sdev->dropped_oldest), dropped_newest, overwritten,
+        replayed);
+}
+static DEVICE_ATTR_RO(stats);
+
+static ssize_t counters_show(struct device *dev,
+    struct device_attribute *attr, char *buf) {
+    struct simtemp_dev *sdev = dev->driver_data;
+    struct simtemp_counters c;
+
+    simtemp_get_counters(sdev, &c);
+
+    return scnprintf(buf, PAGE_SIZE, "samples_dropped: %llu\nreads: %llu\n"
+        "bytes_read: %llu\nwakeups: %llu\npolls: %llu\nempty_reads: %llu\n"
+        "timer_overruns: %llu\nconfig_changes: %llu\n", c.samples_dropped,
+        c.reads, c.bytes_read, c.wakeups, c.polls, c.empty_reads,
+        c.timer_overruns, c.config_changes);
+}
+static DEVICE_ATTR_RO(counters);
+
+static struct attribute *simtemp_attrs[] = {
+    &dev_attr_sampling_ms.attr,
+    &dev_attr_sampling_us.attr,
+    &dev_attr_sampling_ns.attr,
+    &dev_attr_threshold_mC.attr,
+    &dev_attr_hysteresis_mC.attr,
+    &dev_attr_mode.attr,
+    &dev_attr_seed.attr,
+    &dev_attr_replay_speed.attr,
+    &dev_attr_window_ms.attr,
+    &dev_attr_aggregate.attr,
+    &dev_attr_overflow_policy.attr,
+    &dev_attr_fifo_depth.attr,
+    &dev_attr_gen_context.attr,
+    &dev_attr_gen_cpu.attr,
+    &dev_attr_stats.attr,
+    &dev_attr_counters.attr,
+    &dev_attr_timestamp_clock.attr,
+    NULL,
+};
+
+static const struct attribute_group simtemp_group = {
+    .attrs = simtemp_attrs,
+};
+
+/* --- Diagnostics --- */
+
+/**
+ * @brief Account a value in a log2-bucketed histogram.
+ * @param hist Pointer to simtemp_hist.
+ * @param ns Value in nanoseconds.
+ * @note Single writer, readers may see a partially updated histogram.
+ */
+static void simtemp_hist_add(struct simtemp_hist *hist, u64 ns) {
+    u32 bucket = min_t(u32, fls64(ns), SIMTEMP_HIST_BUCKETS - 1);
+
+    WRITE_ONCE(hist->buckets[bucket], hist->buckets[bucket] + 1);
+    WRITE_ONCE(hist->count, hist->count + 1);
+    WRITE_ONCE(hist->sum_ns, hist->sum_ns + ns);
+    if (ns > hist->max_ns) {
+        WRITE_ONCE(hist->max_ns, ns);
+    }
+}
+
+/**
+ * @brief Add every bucket and total of a histogram into another one.
+ * @param dst Pointer to the accumulating simtemp_hist.
+ * @param src Pointer to the simtemp_hist to add.
+ */
+static void simtemp_hist_merge(struct simtemp_hist *dst,
+    const struct simtemp_hist *src) {
+    u32 i;
+
+    for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++) {
+        WRITE_ONCE(dst->buckets[i], dst->buckets[i] + src->buckets[i]);
+    }
+    WRITE_ONCE(dst->count, dst->count + src->count);
+    WRITE_ONCE(dst->sum_ns, dst->sum_ns + src->sum_ns);
+    if (src->max_ns > dst->max_ns) {
+        WRITE_ONCE(dst->max_ns, src->max_ns);
+    }
+}
+
+/**
+ * @brief Estimate a percentile from a log2-bucketed histogram.
+ * @param hist Pointer to simtemp_hist.
+ * @param permille Percentile in tenths of a percent, e.g. 999 for p99.9.
+ * @return Upper bound of the bucket holding the percentile, never above the
+ *         largest recorded value.
+ */
+static u64 simtemp_hist_percentile(const struct simtemp_hist *hist,
+    u32 permille) {
+    u64 target, seen = 0;
+    u32 i;
+
+    if (!hist->count) {
+        return 0;
+    }
+
+    target = DIV_ROUND_UP_ULL(hist->count * permille, 1000);
+    for (i = 0; i < SIMTEMP_HIST_BUCKETS - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            return min_t(u64, i ? (1ULL << i) - 1 : 0, hist->max_ns);
+        }
+    }
+
+    return hist->max_ns;
+}
+
+/**
+ * @brief Summarize a histogram for user space.
+ * @param hist Pointer to a stable simtemp_hist.
+ * @param lat Pointer to the simtemp_latency to fill.
+ */
+static void simtemp_hist_to_latency(const struct simtemp_hist *hist,
+    struct simtemp_latency *lat) {
+    BUILD_BUG_ON(SIMTEMP_HIST_BUCKETS != SIMTEMP_LATENCY_BUCKETS);
+
+    memset(lat, 0, sizeof(*lat));
+    lat->count = hist->count;
+    lat->mean_ns = hist->count ? div64_u64(hist->sum_ns, hist->count) : 0;
+    lat->max_ns = hist->max_ns;
+    lat->p50_ns = simtemp_hist_percentile(hist, 500);
+    lat->p90_ns = simtemp_hist_percentile(hist, 900);
+    lat->p99_ns = simtemp_hist_percentile(hist, 990);
+    lat->p999_ns = simtemp_hist_percentile(hist, 999);
+    memcpy(lat->buckets, hist->buckets, sizeof(lat->buckets));
+}
+
+/**
+ * @brief Record how late a generator tick ran and how many periods it missed.
+ * @param sdev Pointer to simtemp_dev.
+ * @param expires Programmed expiry of the tick.
+ * @param now Time the tick actually started.
+ * @param missed Whole periods skipped after this tick.
+ * @note Called from the single active generator context.
+ */
+static void simtemp_jitter_record(struct simtemp_dev *sdev, ktime_t expires,
+    ktime_t now, u64 missed) {
+    s64 lateness_ns = ktime_to_ns(ktime_sub(now, expires));
+
+    /* Resets are requested from debugfs and applied by the only writer */
+    if (READ_ONCE(sdev->jitter_reset)) {
+        memset(&sdev->jitter, 0, sizeof(sdev->jitter));
+        WRITE_ONCE(sdev->missed_periods, 0);
+        WRITE_ONCE(sdev->jitter_reset, false);
+    }
+
+    simtemp_hist_add(&sdev->jitter, max_t(s64, lateness_ns, 0));
+    if (missed) {
+        WRITE_ONCE(sdev->missed_periods, sdev->missed_periods + missed);
+        simtemp_stat_add(sdev, SIMTEMP_STAT_TIMER_OVERRUNS, 1);
+    }
+}
+
+/* --- Char Device File Operations --- */
+
+/**
+ * @brief Position of a file in the shared history.
+ * @param sfile Pointer to simtemp_file.
+ * @return Sequence number of the next sample the file consumes.
+ */
+static u64 simtemp_file_tail(struct simtemp_file *sfile) {
+    /* Mapped consumers report their position in the control page */
+    struct simtemp_ring_ctrl *ctrl = READ_ONCE(sfile->ctrl);
+    u64 head, tail, size;
+
+    if (!ctrl) {
+        return READ_ONCE(sfile->tail);
+    }
+
+    /* User space owns the page, keep its tail within the history */
+    head = READ_ONCE(sfile->sdev->head);
+    size = READ_ONCE(sfile->sdev->ring_size);
+    tail = READ_ONCE(ctrl->tail);
+    if ((s64)(head - tail) < 0) {
+        return head;
+    }
+
+    return head - tail > size ? head - size : tail;
+}
+
+/**
+ * @brief Continue read() from the position of a mapped consumer.
+ * @param sfile Pointer to simtemp_file.
+ * @return Sequence number of the next sample read() returns.
+ * @note Called with sfile->read_lock held. read() and the control page of
+ *       one file share a cursor, the one wakeups and the deadline track.
+ */
+static u64 simtemp_file_load_tail(struct simtemp_file *sfile) {
+    u64 tail = simtemp_file_tail(sfile);
+
+    if (tail != sfile->tail) {
+        /* The next compact record must not be a delta to a skipped one */
+        sfile->since_sync = SIMTEMP_SYNC_INTERVAL;
+        WRITE_ONCE(sfile->tail, tail);
+    }
+
+    return tail;
+}
+
+/**
+ * @brief Publish the read() position to the control page, if mapped.
+ * @param sfile Pointer to simtemp_file.
+ * @note Called with sfile->read_lock held.
+ */
+static void simtemp_file_store_tail(struct simtemp_file *sfile) {
+    struct simtemp_ring_ctrl *ctrl = READ_ONCE(sfile->ctrl);
+
+    if (ctrl) {
+        WRITE_ONCE(ctrl->tail, sfile->tail);
+    }
+}
+
+/**
+ * @brief Check whether a file has enough samples queued to be woken up.
+ * @param sfile Pointer to simtemp_file.
+ * @param head Ring head to compare with.
+ * @return true once lowat samples are queued after the file position.
+ */
+static bool simtemp_file_ready(struct simtemp_file *sfile, u64 head) {
+    u64 tail = simtemp_file_tail(sfile);
+    u64 lowat = min(READ_ONCE(sfile->lowat),
+        READ_ONCE(sfile->sdev->ring_size) - 1);
+
+    if (head == tail) {
+        return false;
+    }
+
+    return head - tail >= lowat || READ_ONCE(sfile->expired_tail) == tail;
+}
+
+/**
+ * @brief Wake up a file whose oldest queued sample waited max_latency_ns.
+ * @param timer Pointer to the simtemp_file deadline.
+ * @return HRTIMER_NORESTART, the producer arms it again when needed.
+ */
+static enum hrtimer_restart simtemp_deadline_fn(struct hrtimer *timer) {
+    struct simtemp_file *sfile = container_of(timer, struct simtemp_file,
+        deadline);
+
+    /* Stale once the file moved on, it then waits for a new deadline */
+    WRITE_ONCE(sfile->expired_tail, simtemp_file_tail(sfile));
+    wake_up_interruptible_poll(&sfile->wait, POLLIN | POLLRDNORM);
+    simtemp_stat_add(sfile->sdev, SIMTEMP_STAT_WAKEUPS, 1);
+
+    return HRTIMER_NORESTART;
+}
+
+static int simtemp_open(struct inode *inode, struct file *file) {
+    /* The misc core stores the opened miscdevice in private_data */
+    struct simtemp_dev *sdev = container_of(file->private_data,
+        struct simtemp_dev, miscdev);
+    struct simtemp_file *sfile;
+    u64 head;
+
+    sfile = kzalloc(sizeof(*sfile), GFP_KERNEL);
+    if (!sfile) {
+        return -ENOMEM;
+    }
+    sfile->sdev = sdev;
+    mutex_init(&sfile->read_lock);
+    init_waitqueue_head(&sfile->wait);
+    /* Wake up on every sample until the file asks for coalescing */
+    sfile->lowat = 1;
+    sfile->expired_tail = U64_MAX;
+    hrtimer_init(&sfile->deadline, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    sfile->deadline.function = &simtemp_deadline_fn;
+    /* Start with the history still retained in the ring */
+    head = smp_load_acquire(&sdev->head);
+    sfile->tail = head - min_t(u64, head, READ_ONCE(sdev->ring_size) - 1);
+    /* Only transitions from now on */
+    sfile->alert_tail = smp_load_acquire(&sdev->alert_head);
+
+    /* Every open file counts towards the producer's backlog check */
+    spin_lock(&sdev->readers_lock);
+    list_add_tail_rcu(&sfile->node, &sdev->readers);
+    spin_unlock(&sdev->readers_lock);
+
+    file->private_data = sfile;
+    /* read_iter() honours IOCB_NOWAIT, so io_uring can poll instead of block */
+    file->f_mode |= FMODE_NOWAIT;
+    dev_info(sdev->dev, "Device opened.\n");
+    return 0;
+}
+
+/**
+ * @brief Free a file once the producer can no longer see it.
+ * @param rcu Pointer to the simtemp_file rcu_head.
+ */
+static void simtemp_file_free_rcu(struct rcu_head *rcu) {
+    struct simtemp_file *sfile = container_of(rcu, struct simtemp_file, rcu);
+
+    /* Mappings hold a file reference, so the control page is unused here */
+    vfree(sfile->ctrl);
+    kfree(sfile->bounce);
+    kfree(sfile);
+}
+
+static int simtemp_release(struct inode *inode, struct file *file) {
+    struct simtemp_file *sfile = file->private_data;
+    struct simtemp_dev *sdev = sfile->sdev;
+
+    spin_lock(&sdev->readers_lock);
+    list_del_rcu(&sfile->node);
+    spin_unlock(&sdev->readers_lock);
+
+    if (sfile->ring_mapped) {
+        atomic_dec(&sdev->ring_mappers);
+    }
+
+    /*
+     * The producer may still see the file until the grace period ends, keep
+     * it from arming the deadline again before the device can go away.
+     */
+    spin_lock_irq(&sfile->wait.lock);
+    sfile->released = true;
+    spin_unlock_irq(&sfile->wait.lock);
+    hrtimer_cancel(&sfile->deadline);
+
+    /* The producer may still be reading the cursors of this file */
+    call_rcu(&sfile->rcu, simtemp_file_free_rcu);
+    dev_info(sdev->dev, "Device released.\n");
+    return 0;
+}
+
+/**
+ * @brief Move a reader forward if the history wrapped past its cursor.
+ * @param sfile Pointer to simtemp_file.
+ * @param head Current ring head.
+ * @return The reader cursor.
+ * @note Called with sfile->read_lock and sdev->ring_rwsem held.
+ */
+static u64 simtemp_reader_catch_up(struct simtemp_file *sfile, u64 head) {
+    const u64 keep = sfile->sdev->ring_size - 1;
+    u64 lost;
+
+    if (head - sfile->tail > keep) {
+        lost = head - keep - sfile->tail;
+        trace_sample_dropped(sfile->sdev->index, sfile->tail, lost);
+        atomic64_add(lost, &sfile->sdev->dropped_oldest);
+        simtemp_stat_add(sfile->sdev, SIMTEMP_STAT_SAMPLES_DROPPED, lost);
+        WRITE_ONCE(sfile->overruns, sfile->overruns + lost);
+        WRITE_ONCE(sfile->tail, head - keep);
+    }
+
+    return sfile->tail;
+}
+
+/* Smallest read() that always fits the next record of every format */
+static const size_t simtemp_format_min[] = {
+    [SIMTEMP_FMT_LEGACY] = sizeof(struct simtemp_sample),
+    [SIMTEMP_FMT_COMPACT] = sizeof(struct simtemp_sample_sync),
+    [SIMTEMP_FMT_RAW] = sizeof(__u32),
+};
+
+/* Samples encoded per chunk, in place in the PAGE_SIZE bounce buffer */
+#define SIMTEMP_BOUNCE_SAMPLES (PAGE_SIZE / sizeof(struct simtemp_sample))
+
+/**
+ * @brief Pack a temperature and its flags into a single word.
+ * @param sample Pointer to simtemp_sample.
+ * @return temp_mC in bits 0..23, flags in bits 24..31.
+ */
+static u32 simtemp_temp_flags(const struct simtemp_sample *sample) {
+    return min_t(u32, sample->temp_mC, SIMTEMP_TEMP_MASK) |
+        (u32)(sample->flags & 0x7f) << SIMTEMP_FLAGS_SHIFT;
+}
+
+/**
+ * @brief Encode samples in place into the format of a file.
+ * @param sfile Pointer to simtemp_file.
+ * @param buf Samples to encode, overwritten with the records.
+ * @param n Number of samples in buf.
+ * @param room Bytes available for the records.
+ * @param hist Histogram accounting the age of every encoded sample.
+ * @param used Returns the number of samples encoded.
+ * @return Number of record bytes in buf.
+ * @note No record is bigger than the sample it encodes, so record i never
+ *       overwrites a sample after i.
+ */
+static size_t simtemp_encode(struct simtemp_file *sfile, void *buf, size_t n,
+    size_t room, struct simtemp_hist *hist, size_t *used) {
+    struct simtemp_sample *samples = buf;
+    struct simtemp_sample sample;
+    struct simtemp_sample_sync sync;
+    struct simtemp_sample_compact rec;
+    u64 now_ns = simtemp_clock_ns(sfile->sdev);
+    u64 delta_us;
+    size_t out = 0, i;
+    u32 raw;
+
+    for (i = 0; i < n; i++) {
+        sample = samples[i];
+
+        if (sfile->format == SIMTEMP_FMT_RAW) {
+            if (room - out < sizeof(raw)) {
+                break;
+            }
+            raw = simtemp_temp_flags(&sample);
+            memcpy(buf + out, &raw, sizeof(raw));
+            out += sizeof(raw);
+        } else {
+            delta_us = div_u64(sample.timestamp_ns - sfile->sync_ns,
+                NSEC_PER_USEC);
+            if (sfile->since_sync >= SIMTEMP_SYNC_INTERVAL ||
+                sample.timestamp_ns < sfile->sync_ns || delta_us > U32_MAX) {
+                if (room - out < sizeof(sync)) {
+                    break;
+                }
+                sync.rec.delta_us = 0;
+                sync.rec.temp_flags = simtemp_temp_flags(&sample) |
+                    (u32)SIMTEMP_SYNC << SIMTEMP_FLAGS_SHIFT;
+                sync.timestamp_ns = sample.timestamp_ns;
+                memcpy(buf + out, &sync, sizeof(sync));
+                out += sizeof(sync);
+                sfile->sync_ns = sample.timestamp_ns;
+                sfile->since_sync = 0;
+            } else {
+                if (room - out < sizeof(rec)) {
+                    break;
+                }
+                rec.delta_us = delta_us;
+                rec.temp_flags = simtemp_temp_flags(&sample);
+                memcpy(buf + out, &rec, sizeof(rec));
+                out += sizeof(rec);
+                sfile->since_sync++;
+            }
+        }
+
+        simtemp_hist_add(hist, now_ns > sample.timestamp_ns ?
+            now_ns - sample.timestamp_ns : 0);
+    }
+
+    *used = i;
+    return out;
+}
+
+/**
+ * @brief read() for the compact and raw formats.
+ * @param sfile Pointer to simtemp_file.
+ * @param to Destination of the records.
+ * @param hist Histogram accounting the age of every delivered sample.
+ * @return Number of bytes copied, -EFAULT on failure.
+ * @note Called with sfile->read_lock and sdev->ring_rwsem held. Samples are
+ *       snapshotted into the bounce buffer, validated against the producer
+ *       and only then encoded and copied out.
+ */
+static ssize_t simtemp_read_encoded(struct simtemp_file *sfile,
+    struct iov_iter *to, struct simtemp_hist *hist) {
+    struct simtemp_dev *sdev = sfile->sdev;
+    struct simtemp_sample *bounce = sfile->bounce;
+    const u64 mask = sdev->ring_size - 1;
+    size_t done = 0, n, first, out, used;
+    u64 head, tail, rewrite_seq, overruns;
+
+    while (iov_iter_count(to) >= simtemp_format_min[sfile->format]) {
+        overruns = sfile->overruns;
+        rewrite_seq = smp_load_acquire(&sdev->ring->rewrite_seq);
+        head = smp_load_acquire(&sdev->ring->head);
+        tail = simtemp_reader_catch_up(sfile, head);
+        n = min_t(u64, head - tail, SIMTEMP_BOUNCE_SAMPLES);
+        if (!n) {
+            break;
+        }
+
+        first = min_t(size_t, n, mask + 1 - (tail & mask));
+        memcpy(bounce, &sdev->ring_data[tail & mask], first * sizeof(*bounce));
+        memcpy(bounce + first, sdev->ring_data, (n - first) * sizeof(*bounce));
+        smp_rmb();
+        if (READ_ONCE(sdev->ring->head) - tail > mask || (rewrite_seq & 1) ||
+            READ_ONCE(sdev->ring->rewrite_seq) != rewrite_seq) {
+            continue;  // Lapped or rewritten while copying
+        }
+
+        /* This reader lost samples right before the first one it gets now */
+        if (sfile->overruns != overruns) {
+            bounce[0].flags |= DATA_GAP;
+        }
+
+        out = simtemp_encode(sfile, bounce, n, iov_iter_count(to), hist,
+            &used);
+        if (copy_to_iter(bounce, out, to) != out) {
+            /* The sync state may be ahead of what user space got */
+            sfile->since_sync = SIMTEMP_SYNC_INTERVAL;
+            return done ? done : -EFAULT;
+        }
+        WRITE_ONCE(sfile->tail, tail + used);
+        trace_sample_read(sdev->index, tail, used);
+        done += out;
+        if (used < n) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+static ssize_t simtemp_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    struct file *file = iocb->ki_filp;
+    struct simtemp_file *sfile = file->private_data;
+    struct simtemp_dev *sdev = sfile->sdev;
+    const size_t size = sizeof(struct simtemp_sample);
+    /* io_uring asks for a non blocking attempt first */
+    const bool nowait = (file->f_flags & O_NONBLOCK) ||
+        (iocb->ki_flags & IOCB_NOWAIT);
+    struct simtemp_sample first_sample;
+    struct simtemp_hist delivered;
+    size_t n, first, i, copied;
+    u64 head, tail, now_ns, ts_ns, rewrite_seq, overruns, mask;
+    ssize_t ret;
+
+    if (nowait) {
+        if (!mutex_trylock(&sfile->read_lock)) {
+            return -EAGAIN;
+        }
+    } else if (mutex_lock_interruptible(&sfile->read_lock)) {
+        return -ERESTARTSYS;
+    }
+
+    if (iov_iter_count(to) < simtemp_format_min[sfile->format]) {
+        ret = -EINVAL;
+        goto out;
+    }
+    /* From now on this file holds back the drop-newest policy */
+    WRITE_ONCE(sfile->consuming, true);
+
+wait:
+    if (smp_load_acquire(&sdev->head) == simtemp_file_load_tail(sfile)) {
+        if (nowait) {
+            simtemp_stat_add(sdev, SIMTEMP_STAT_EMPTY_READS, 1);
+            ret = -EAGAIN;
+            goto out;
+        }
+
+        /*
+         * The producer wakes this file once its watermark or deadline hits,
+         * both tracked on the same cursor read() continues from.
+         */
+        ret = wait_event_interruptible(sfile->wait,
+            simtemp_file_ready(sfile, smp_load_acquire(&sdev->head)));
+        if (ret) {
+            goto out;  // Signal received
+        }
+        /* A mapped consumer may have moved the cursor meanwhile */
+        simtemp_file_load_tail(sfile);
+    }
+
+    /* Keep the ring from being resized while copying from it */
+    if (nowait) {
+        if (!down_read_trylock(&sdev->ring_rwsem)) {
+            ret = -EAGAIN;
+            goto out;
+        }
+    } else {
+        down_read(&sdev->ring_rwsem);
+    }
+    if (sfile->format != SIMTEMP_FMT_LEGACY) {
+        memset(&delivered, 0, sizeof(delivered));
+        ret = simtemp_read_encoded(sfile, to, &delivered);
+        up_read(&sdev->ring_rwsem);
+        if (ret > 0) {
+            goto account;
+        }
+        if (!ret && smp_load_acquire(&sdev->head) == sfile->tail) {
+            goto wait;  // Nothing queued after all
+        }
+        goto out;
+    }
+    mask = sdev->ring_size - 1;
+
+    /*
+     * Copy as many whole samples as fit in the destination straight from the
+     * shared history. The producer never waits for readers, so retry if it
+     * lapped the oldest copied slot meanwhile.
+     */
+    overruns = sfile->overruns;
+    do {
+        /* An odd value never matches the re-check, forcing a retry */
+        rewrite_seq = smp_load_acquire(&sdev->ring->rewrite_seq);
+        head = smp_load_acquire(&sdev->ring->head);
+        tail = simtemp_reader_catch_up(sfile, head);
+        n = min_t(u64, head - tail, iov_iter_count(to) / size);
+        if (!n) {
+            /* Nothing to copy, never touch the slot at tail */
+            up_read(&sdev->ring_rwsem);
+            goto wait;
+        }
+        first = min_t(size_t, n, mask + 1 - (tail & mask));
+
+        /* This reader lost samples right before the first one it gets now */
+        first_sample = sdev->ring_data[tail & mask];
+        if (sfile->overruns != overruns) {
+            first_sample.flags |= DATA_GAP;
+        }
+        copied = copy_to_iter(&first_sample, size, to);
+        copied += copy_to_iter(&sdev->ring_data[(tail + 1) & mask],
+            (first - 1) * size, to);
+        copied += copy_to_iter(sdev->ring_data, (n - first) * size, to);
+        if (copied != n * size) {
+            ret = -EFAULT;
+            goto out_unlock;
+        }
+
+        /* Age of every sample handed out, discarded if the copy is retried */
+        memset(&delivered, 0, sizeof(delivered));
+        now_ns = simtemp_clock_ns(sdev);
+        for (i = 0; i < n; i++) {
+            ts_ns = READ_ONCE(sdev->ring_data[(tail + i) & mask].timestamp_ns);
+            simtemp_hist_add(&delivered, now_ns > ts_ns ? now_ns - ts_ns : 0);
+        }
+        smp_rmb();
+        if (READ_ONCE(sdev->ring->head) - tail <= mask && !(rewrite_seq & 1) &&
+            READ_ONCE(sdev->ring->rewrite_seq) == rewrite_seq) {
+            break;
+        }
+        /* Lapped or rewritten while copying, copy again */
+        iov_iter_revert(to, copied);
+    } while (1);
+    up_read(&sdev->ring_rwsem);
+
+    WRITE_ONCE(sfile->tail, tail + n);
+    ret = n * size;
+    trace_sample_read(sdev->index, tail, n);
+
+account:
+    simtemp_file_store_tail(sfile);
+    simtemp_stat_add(sdev, SIMTEMP_STAT_READS, 1);
+    simtemp_stat_add(sdev, SIMTEMP_STAT_BYTES_READ, ret);
+    simtemp_hist_merge(&sfile->latency, &delivered);
+    spin_lock(&sdev->latency_lock);
+    simtemp_hist_merge(&sdev->latency, &delivered);
+    spin_unlock(&sdev->latency_lock);
+    goto out;
+
+out_unlock:
+    up_read(&sdev->ring_rwsem);
+out:
+    mutex_unlock(&sfile->read_lock);
+    return ret;
+}
+
+/**
+ * @brief Decode one record written in the format of a file.
+ * @param sfile Pointer to simtemp_file.
+ * @param buf Record bytes.
+ * @param len Bytes available in buf.
+ * @param sample Returns the decoded sample.
+ * @return Bytes used by the record, 0 if it is incomplete, negative errno if
+ *         it is invalid.
+ * @note Called with sdev->replay_lock held, SIMTEMP_IOC_SET_FORMAT takes it
+ *       too before changing the format or the write sync state.
+ */
+static ssize_t simtemp_decode(struct simtemp_file *sfile, const void *buf,
+    size_t len, struct simtemp_sample *sample) {
+    struct simtemp_sample_compact rec;
+    u32 flags;
+
+    if (sfile->format == SIMTEMP_FMT_LEGACY) {
+        if (len < sizeof(*sample)) {
+            return 0;
+        }
+        memcpy(sample, buf, sizeof(*sample));
+        return sizeof(*sample);
+    }
+
+    /* Raw records carry no timing to replay */
+    if (sfile->format != SIMTEMP_FMT_COMPACT) {
+        return -EINVAL;
+    }
+
+    if (len < sizeof(rec)) {
+        return 0;
+    }
+    memcpy(&rec, buf, sizeof(rec));
+    flags = rec.temp_flags >> SIMTEMP_FLAGS_SHIFT;
+    sample->temp_mC = rec.temp_flags & SIMTEMP_TEMP_MASK;
+    sample->flags = flags & ~SIMTEMP_SYNC;
+
+    if (flags & SIMTEMP_SYNC) {
+        if (len < sizeof(struct simtemp_sample_sync)) {
+            return 0;
+        }
+        memcpy(&sfile->write_sync_ns,
+            buf + offsetof(struct simtemp_sample_sync, timestamp_ns),
+            sizeof(sfile->write_sync_ns));
+        sample->timestamp_ns = sfile->write_sync_ns;
+        return sizeof(struct simtemp_sample_sync);
+    }
+
+    /* Deltas are meaningless before the first sync record */
+    if (!sfile->write_sync_ns) {
+        return -EINVAL;
+    }
+    sample->timestamp_ns = sfile->write_sync_ns +
+        (u64)rec.delta_us * NSEC_PER_USEC;
+    return sizeof(rec);
+}
+
+/**
+ * @brief Queue recorded samples for replay.
+ * @note Records use the format of the file (legacy or compact) and play
+ *       while the device is in replay mode. A full queue fails with -EAGAIN
+ *       outside replay mode, nothing would ever drain it.
+ */
+static ssize_t simtemp_write(struct file *file, const char __user *buf,
+    size_t count, loff_t *ppos) {
+    struct simtemp_file *sfile = file->private_data;
+    struct simtemp_dev *sdev = sfile->sdev;
+    struct simtemp_sample sample;
+    size_t done = 0, chunk, off;
+    ssize_t used, err = 0;
+
+    if (mutex_lock_interruptible(&sdev->replay_lock)) {
+        return -ERESTARTSYS;
+    }
+
+    while (done < count) {
+        if (kfifo_is_full(&sdev->replay)) {
+            if (done) {
+                break;
+            }
+            /* The producer only makes room in replay mode */
+            if ((file->f_flags & O_NONBLOCK) ||
+                READ_ONCE(sdev->mode) != MODE_REPLAY) {
+                err = -EAGAIN;
+                break;
+            }
+            err = wait_event_interruptible(sdev->replay_wait,
+                !kfifo_is_full(&sdev->replay) ||
+                READ_ONCE(sdev->mode) != MODE_REPLAY);
+            if (err) {
+                break;
+            }
+            continue;  // Check the queue and the mode again
+        }
+
+        chunk = min_t(size_t, count - done, PAGE_SIZE);
+        if (copy_from_user(sdev->replay_buf, buf + done, chunk)) {
+            err = -EFAULT;
+            break;
+        }
+
+        /* Queue whole records only, a partial one is left to the caller */
+        used = 0;
+        for (off = 0; !kfifo_is_full(&sdev->replay); off += used) {
+            used = simtemp_decode(sfile, sdev->replay_buf + off, chunk - off,
+                &sample);
+            if (used <= 0) {
+                break;
+            }
+            kfifo_put(&sdev->replay, sample);
+        }
+        done += off;
+
+        if (used < 0) {
+            err = used;
+            break;
+        }
+        if (used == 0 && off == 0) {
+            err = -EINVAL;  // Not even one complete record
+            break;
+        }
+    }
+
+    mutex_unlock(&sdev->replay_lock);
+    return done ? done : err;
+}
+
+/**
+ * @brief Copy the oldest alert after a cursor and advance it.
+ * @param sdev Pointer to simtemp_dev.
+ * @param tail Alert cursor, serialized by the caller.
+ * @param alert Pointer to the simtemp_alert to fill.
+ * @return 0 on success, -EAGAIN when there is no new alert.
+ */
+static int simtemp_alert_copy(struct simtemp_dev *sdev, u64 *tail,
+    struct simtemp_alert *alert) {
+    u64 head, lost = 0;
+
+    do {
+        head = smp_load_acquire(&sdev->alert_head);
+        if (head == *tail) {
+            return -EAGAIN;
+        }
+        /* Skip what the producer already overwrote */
+        if (head - *tail > ALERT_DEPTH - 1) {
+            lost += head - (ALERT_DEPTH - 1) - *tail;
+            *tail = head - (ALERT_DEPTH - 1);
+        }
+        *alert = sdev->alerts[*tail & (ALERT_DEPTH - 1)];
+        /* Order the copy before re-checking that it was not overwritten */
+        smp_rmb();
+    } while (READ_ONCE(sdev->alert_head) - *tail > ALERT_DEPTH - 1);
+    (*tail)++;
+
+    alert->lost = min_t(u64, lost, U32_MAX);
+    return 0;
+}
+
+/**
+ * @brief Return the oldest alert this file has not read yet.
+ * @param sfile Pointer to simtemp_file.
+ * @param alert Pointer to the simtemp_alert to fill.
+ * @return 0 on success, -EAGAIN when there is no new alert.
+ * @note Alerts are kept apart from the samples, so reading them does not
+ *       consume samples and vice versa.
+ */
+static int simtemp_alert_pop(struct simtemp_file *sfile,
+    struct simtemp_alert *alert) {
+    int ret;
+
+    mutex_lock(&sfile->read_lock);
+    ret = simtemp_alert_copy(sfile->sdev, &sfile->alert_tail, alert);
+    mutex_unlock(&sfile->read_lock);
+
+    return ret;
+}
+
+static __poll_t simtemp_poll(struct file *file,
+    struct poll_table_struct *wait) {
+    __poll_t mask = 0;
+    struct simtemp_file *sfile = file->private_data;
+    struct simtemp_dev *sdev = sfile->sdev;
+    u64 head;
+
+    simtemp_stat_add(sdev, SIMTEMP_STAT_POLLS, 1);
+    poll_wait(file, &sfile->wait, wait);
+    poll_wait(file, &sdev->replay_wait, wait);
+
+    /* Same condition blocking read() waits for */
+    head = smp_load_acquire(&sdev->head);
+    if (simtemp_file_ready(sfile, head)) {
+        mask |= POLLIN | POLLRDNORM;
+    }
+    if (smp_load_acquire(&sdev->alert_head) != READ_ONCE(sfile->alert_tail)) {
+        mask |= POLLPRI;
+    }
+    /* Records are only consumed in replay mode, don't make writers spin */
+    if (READ_ONCE(sdev->mode) == MODE_REPLAY &&
+        !kfifo_is_full(&sdev->replay)) {
+        mask |= POLLOUT | POLLWRNORM;
+    }
+
+    return mask;
+}
+
+/**
+ * @brief Snapshot the whole configuration of a device.
+ * @param sdev Pointer to simtemp_dev.
+ * @param cfg Pointer to the simtemp_dev_config to fill.
+ */
+static void simtemp_get_config(struct simtemp_dev *sdev,
+    struct simtemp_dev_config *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->version = SIMTEMP_DEV_CONFIG_VERSION;
+    cfg->mask = SIMTEMP_CFG_F_ALL;
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    cfg->sampling_ns = sdev->sampling_ns;
+    cfg->seed = sdev->seed;
+    cfg->threshold_mC = sdev->threshold_mC;
+    cfg->hysteresis_mC = sdev->hysteresis_mC;
+    cfg->mode = sdev->mode;
+    cfg->overflow_policy = sdev->overflow_policy;
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+
+    cfg->fifo_depth = READ_ONCE(sdev->ring_size);
+    cfg->gen_context = READ_ONCE(sdev->gen_context);
+    cfg->gen_cpu = READ_ONCE(sdev->gen_cpu);
+    cfg->window_ms = READ_ONCE(sdev->window_ms);
+    cfg->replay_speed = READ_ONCE(sdev->replay_speed);
+}
+
+/**
+ * @brief Apply the configuration fields selected by cfg->mask.
+ * @param sdev Pointer to simtemp_dev.
+ * @param cfg Pointer to the simtemp_dev_config to apply.
+ * @return 0 on success, -EINVAL if any selected field is invalid, -EBUSY if
+ *         the history must be resized while mapped, different than 0 if
+ *         resizing the history or moving the generator failed.
+ * @note Nothing is applied unless every field is valid and the history can be
+ *       resized. Only running out of memory or a mapping racing with the
+ *       resize can still fail midway, then the fields applied before stay.
+ *       The fields that can fail go before the others, the resize last.
+ */
+static int simtemp_set_fields(struct simtemp_dev *sdev,
+    const struct simtemp_dev_config *cfg) {
+    const u32 mask = cfg->mask;
+    bool resize;
+    int err;
+
+    if (cfg->version != SIMTEMP_DEV_CONFIG_VERSION || cfg->reserved ||
+        (mask & ~SIMTEMP_CFG_F_ALL)) {
+        return -EINVAL;
+    }
+    if (((mask & SIMTEMP_CFG_F_SAMPLING_NS) &&
+            (cfg->sampling_ns < MIN_SAMPLE_NS ||
+            cfg->sampling_ns > MAX_SAMPLE_NS)) ||
+        ((mask & SIMTEMP_CFG_F_MODE) &&
+            cfg->mode >= ARRAY_SIZE(simtemp_models)) ||
+        ((mask & SIMTEMP_CFG_F_OVERFLOW_POLICY) &&
+            cfg->overflow_policy >= ARRAY_SIZE(overflow_policy_names)) ||
+        ((mask & SIMTEMP_CFG_F_FIFO_DEPTH) &&
+            !simtemp_ring_depth(cfg->fifo_depth)) ||
+        ((mask & SIMTEMP_CFG_F_GEN_CONTEXT) &&
+            (cfg->gen_context >= ARRAY_SIZE(gen_context_names) ||
+            cfg->gen_cpu < -1 || (cfg->gen_cpu >= 0 &&
+            (cfg->gen_cpu >= nr_cpu_ids || !cpu_online(cfg->gen_cpu))))) ||
+        ((mask & SIMTEMP_CFG_F_WINDOW_MS) &&
+            (cfg->window_ms < MIN_WINDOW_MS ||
+            cfg->window_ms > MAX_WINDOW_MS))) {
+        return -EINVAL;
+    }
+
+    /* A mapped ring can't be resized, fail before touching anything */
+    resize = (mask & SIMTEMP_CFG_F_FIFO_DEPTH) &&
+        simtemp_ring_depth(cfg->fifo_depth) != READ_ONCE(sdev->ring_size);
+    if (resize && atomic_read(&sdev->ring_mappers)) {
+        return -EBUSY;
+    }
+
+    if (mask & SIMTEMP_CFG_F_GEN_CONTEXT) {
+        /* Keeps the previous context if the new one can't start */
+        err = simtemp_set_gen_context(sdev, cfg->gen_context, cfg->gen_cpu);
+        if (err) {
+            return err;
+        }
+    }
+    if (mask & SIMTEMP_CFG_F_SAMPLING_NS) {
+        err = simtemp_set_period(sdev, cfg->sampling_ns);
+        if (err) {
+            return err;
+        }
+    }
+    if (resize) {
+        err = simtemp_resize_ring(sdev, cfg->fifo_depth);
+        if (err) {
+            return err;
+        }
+    }
+
+    /* START CRITICAL BLOCK */
+    spin_lock(&sdev->lock);
+    if (mask & SIMTEMP_CFG_F_THRESHOLD_MC) {
+        WRITE_ONCE(sdev->threshold_mC, cfg->threshold_mC);
+    }
+    if (mask & SIMTEMP_CFG_F_HYSTERESIS_MC) {
+        WRITE_ONCE(sdev->hysteresis_mC, cfg->hysteresis_mC);
+    }
+    if (mask & SIMTEMP_CFG_F_MODE) {
+        WRITE_ONCE(sdev->mode, cfg->mode);
+    }
+    if (mask & SIMTEMP_CFG_F_OVERFLOW_POLICY) {
+        WRITE_ONCE(sdev->overflow_policy, cfg->overflow_policy);
+    }
+    if (mask & SIMTEMP_CFG_F_SEED) {
+        WRITE_ONCE(sdev->seed, cfg->seed);
+        WRITE_ONCE(sdev->reseed, true);
+    }
+    spin_unlock(&sdev->lock);
+    /* END CRITICAL BLOCK */
+    if (mask & SIMTEMP_CFG_F_WINDOW_MS) {
+        WRITE_ONCE(sdev->window_ms, cfg->window_ms);
+        simtemp_config_changed(sdev, SIMTEMP_CFG_WINDOW_MS, cfg->window_ms);
+    }
+    if (mask & SIMTEMP_CFG_F_REPLAY_SPEED) {
+        WRITE_ONCE(sdev->replay_speed, cfg->replay_speed);
+        simtemp_config_changed(sdev, SIMTEMP_CFG_REPLAY_SPEED,
+            cfg->replay_speed);
+    }
+
+    if (mask & SIMTEMP_CFG_F_THRESHOLD_MC) {
+        simtemp_config_changed(sdev, SIMTEMP_CFG_THRESHOLD_MC,
+            cfg->threshold_mC);
+    }
+    if (mask & SIMTEMP_CFG_F_HYSTERESIS_MC) {
+        simtemp_config_changed(sdev, SIMTEMP_CFG_HYSTERESIS_MC,
+            cfg->hysteresis_mC);
+    }
+    if (mask & SIMTEMP_CFG_F_MODE) {
+        simtemp_config_changed(sdev, SIMTEMP_CFG_MODE, cfg->mode);
+    }
+    if (mask & SIMTEMP_CFG_F_OVERFLOW_POLICY) {
+        simtemp_config_changed(sdev, SIMTEMP_CFG_OVERFLOW_POLICY,
+            cfg->overflow_policy);
+    }
+    if (mask & SIMTEMP_CFG_F_SEED) {
+        simtemp_config_changed(sdev, SIMTEMP_CFG_SEED, cfg->seed);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Snapshot the device counters and the position of a file.
+ * @param sfile Pointer to simtemp_file.
+ * @param stats Pointer to the simtemp_dev_stats to fill.
+ */
+static void simtemp_get_stats(struct simtemp_file *sfile,
+    struct simtemp_dev_stats *stats) {
+    struct simtemp_dev *sdev = sfile->sdev;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->version = SIMTEMP_DEV_STATS_VERSION;
+    /* Written by the producer only */
+    stats->samples_taken = READ_ONCE(sdev->samples_taken);
+    stats->threshold_alerts = READ_ONCE(sdev->threshold_alerts);
+    stats->dropped_oldest = atomic64_read(&sdev->dropped_oldest);
+    stats->dropped_newest = READ_ONCE(sdev->dropped_newest);
+    stats->overwritten = READ_ONCE(sdev->overwritten);
+    stats->replayed = READ_ONCE(sdev->replayed);
+    stats->missed_periods = READ_ONCE(sdev->missed_periods);
+    stats->head = smp_load_acquire(&sdev->head);
+    stats->overruns = READ_ONCE(sfile->overruns);
+    stats->queued = min_t(u64, stats->head - simtemp_file_tail(sfile),
+        READ_ONCE(sdev->ring_size) - 1);
+}
+
+/**
+ * @brief Copy the newest sample without moving any reader.
+ * @param sdev Pointer to simtemp_dev.
+ * @param latest Pointer to the simtemp_latest to fill.
+ * @return 0 on success, -EAGAIN before the first sample.
+ */
+static int simtemp_get_latest(struct simtemp_dev *sdev,
+    struct simtemp_latest *latest) {
+    u64 head, rewrite_seq, mask;
+
+    memset(latest, 0, sizeof(*latest));
+    latest->version = SIMTEMP_LATEST_VERSION;
+
+    down_read(&sdev->ring_rwsem);
+    mask = sdev->ring_size - 1;
+    do {
+        rewrite_seq = smp_load_acquire(&sdev->ring->rewrite_seq);
+        head = smp_load_acquire(&sdev->ring->head);
+        if (!head) {
+            up_read(&sdev->ring_rwsem);
+            return -EAGAIN;
+        }
+        latest->seq = head - 1;
+        latest->sample = sdev->ring_data[latest->seq & mask];
+        smp_rmb();
+    } while (READ_ONCE(sdev->ring->head) - latest->seq > mask ||
+        (rewrite_seq & 1) || READ_ONCE(sdev->ring->rewrite_seq) != rewrite_seq);
+    up_read(&sdev->ring_rwsem);
+
+    return 0;
+}
+
+/**
+ * @brief Drop the backlog of a file, read() continues with the next sample.
+ * @param sfile Pointer to simtemp_file.
+ */
+static void simtemp_flush(struct simtemp_file *sfile) {
+    mutex_lock(&sfile->read_lock);
+    WRITE_ONCE(sfile->tail, smp_load_acquire(&sfile->sdev->head));
+    simtemp_file_store_tail(sfile);
+    /* The next compact record must not be a delta to a skipped one */
+    sfile->since_sync = SIMTEMP_SYNC_INTERVAL;
+    mutex_unlock(&sfile->read_lock);
+}
+
+static long simtemp_ioctl(struct file *file, unsigned int cmd,
+    unsigned long arg) {
+    struct simtemp_file *sfile = file->private_data;
+    struct simtemp_dev *sdev = sfile->sdev;
+    struct simtemp_config cfg;
+    struct simtemp_latency lat;
+    struct simtemp_aggregate agg;
+    struct simtemp_alert alert;
+    struct simtemp_wakeup wakeup;
+    struct simtemp_dev_config dev_cfg;
+    struct simtemp_dev_stats stats;
+    struct simtemp_latest latest;
+    struct simtemp_counters counters;
+    struct simtemp_clock clk;
+    u64 sampling_ns;
+    u32 depth, format;
+    int err = 0;
+
+
+    if (_IOC_TYPE(cmd) != SIMTEMP_IOC_MAGIC)
+        return -ENOTTY;
+
+    switch (cmd) {
+        case SIMTEMP_IOC_SET_ALL:
+            if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg))) {
+                return -EFAULT;
+            }
+            if (cfg.mode >= ARRAY_SIZE(simtemp_models)) {
+                return -EINVAL;
+            }
+
+            err = simtemp_set_period(sdev,
+                (u64)cfg.sampling_ms * NSEC_PER_MSEC);
+            if (err) {
+                return err;
+            }
+
+            /* START CRITICAL BLOCK */
+            spin_lock(&sdev->lock);
+            WRITE_ONCE(sdev->threshold_mC, cfg.threshold_mC);
+            WRITE_ONCE(sdev->mode, cfg.mode);
+            spin_unlock(&sdev->lock);
+            /* END CRITICAL BLOCK */
+            simtemp_config_changed(sdev, SIMTEMP_CFG_THRESHOLD_MC,
+                cfg.threshold_mC);
+            simtemp_config_changed(sdev, SIMTEMP_CFG_MODE, cfg.mode);
+            dev_info(sdev->dev, "Config updated via ioctl.\n");
+            break;
+        case SIMTEMP_IOC_SET_SAMPLING_NS:
+            if (get_user(sampling_ns, (u64 __user *)arg)) {
+                return -EFAULT;
+            }
+            err = simtemp_set_period(sdev, sampling_ns);
+            break;
+        case SIMTEMP_IOC_SET_FIFO_DEPTH:
+            if (get_user(depth, (u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            err = simtemp_resize_ring(sdev, depth);
+            break;
+        case SIMTEMP_IOC_SET_FORMAT:
+            if (get_user(format, (u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            if (format >= ARRAY_SIZE(simtemp_format_min)) {
+                return -EINVAL;
+            }
+
+            if (mutex_lock_interruptible(&sfile->read_lock)) {
+                return -ERESTARTSYS;
+            }
+            if (format != SIMTEMP_FMT_LEGACY && !sfile->bounce) {
+                sfile->bounce = kmalloc(PAGE_SIZE, GFP_KERNEL);
+                if (!sfile->bounce) {
+                    mutex_unlock(&sfile->read_lock);
+                    return -ENOMEM;
+                }
+            }
+            /*
+             * write() decodes under replay_lock only, read() may sleep with
+             * read_lock held waiting for the samples write() queues.
+             */
+            if (mutex_lock_interruptible(&sdev->replay_lock)) {
+                mutex_unlock(&sfile->read_lock);
+                return -ERESTARTSYS;
+            }
+            sfile->format = format;
+            /* Start the compact stream with a sync record */
+            sfile->since_sync = SIMTEMP_SYNC_INTERVAL;
+            sfile->write_sync_ns = 0;
+            mutex_unlock(&sdev->replay_lock);
+            mutex_unlock(&sfile->read_lock);
+            break;
+        case SIMTEMP_IOC_GET_FORMAT:
+            if (put_user(READ_ONCE(sfile->format), (u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_GET_CONFIG:
+            simtemp_get_config(sdev, &dev_cfg);
+            if (copy_to_user((void __user *)arg, &dev_cfg, sizeof(dev_cfg))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_SET_FIELDS:
+            if (copy_from_user(&dev_cfg, (void __user *)arg, sizeof(dev_cfg))) {
+                return -EFAULT;
+            }
+            err = simtemp_set_fields(sdev, &dev_cfg);
+            if (err) {
+                return err;
+            }
+            dev_info(sdev->dev, "Config fields 0x%x updated via ioctl.\n",
+                dev_cfg.mask);
+            break;
+        case SIMTEMP_IOC_GET_STATS:
+            simtemp_get_stats(sfile, &stats);
+            if (copy_to_user((void __user *)arg, &stats, sizeof(stats))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_GET_COUNTERS:
+            simtemp_get_counters(sdev, &counters);
+            if (copy_to_user((void __user *)arg, &counters,
+                sizeof(counters))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_GET_CLOCK:
+            memset(&clk, 0, sizeof(clk));
+            clk.clock = READ_ONCE(sdev->clock);
+            clk.clockid = clock_ids[clk.clock];
+            clk.fast = clk.clock >= TSCLK_REALTIME_FAST;
+            if (copy_to_user((void __user *)arg, &clk, sizeof(clk))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_SET_CLOCK:
+            if (copy_from_user(&clk, (void __user *)arg, sizeof(clk))) {
+                return -EFAULT;
+            }
+            err = simtemp_set_clock(sdev, clk.clock);
+            break;
+        case SIMTEMP_IOC_GET_LATEST:
+            err = simtemp_get_latest(sdev, &latest);
+            if (err) {
+                return err;
+            }
+            if (copy_to_user((void __user *)arg, &latest, sizeof(latest))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_FLUSH:
+            simtemp_flush(sfile);
+            break;
+        case SIMTEMP_IOC_SET_WAKEUP:
+            if (copy_from_user(&wakeup, (void __user *)arg, sizeof(wakeup))) {
+                return -EFAULT;
+            }
+            if (!wakeup.lowat || wakeup.lowat > MAX_RING_SIZE ||
+                wakeup.reserved) {
+                return -EINVAL;
+            }
+            WRITE_ONCE(sfile->lowat, wakeup.lowat);
+            WRITE_ONCE(sfile->max_latency_ns, wakeup.max_latency_ns);
+            /* Let sleepers re-evaluate with the new watermark */
+            wake_up_interruptible_poll(&sfile->wait, POLLIN | POLLRDNORM);
+            break;
+        case SIMTEMP_IOC_GET_WAKEUP:
+            memset(&wakeup, 0, sizeof(wakeup));
+            wakeup.lowat = READ_ONCE(sfile->lowat);
+            wakeup.max_latency_ns = READ_ONCE(sfile->max_latency_ns);
+            if (copy_to_user((void __user *)arg, &wakeup, sizeof(wakeup))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_GET_ALERT:
+            err = simtemp_alert_pop(sfile, &alert);
+            if (err) {
+                return err;
+            }
+            if (copy_to_user((void __user *)arg, &alert, sizeof(alert))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_GET_AGGREGATE:
+            simtemp_get_aggregate(sdev, &agg);
+            if (copy_to_user((void __user *)arg, &agg, sizeof(agg))) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_GET_OVERRUNS:
+            if (put_user(READ_ONCE(sfile->overruns), (u64 __user *)arg)) {
+                return -EFAULT;
+            }
+            break;
+        case SIMTEMP_IOC_GET_LATENCY:
+            if (mutex_lock_interruptible(&sfile->read_lock)) {
+                return -ERESTARTSYS;
+            }
+            simtemp_hist_to_latency(&sfile->latency, &lat);
+            mutex_unlock(&sfile->read_lock);
+
+            if (copy_to_user((void __user *)arg, &lat, sizeof(lat))) {
+                return -EFAULT;
+            }
+            break;
+        default:
+            err = -ENOTTY;
+            break;
+    }
+
+    return err;
+}
+
+static int simtemp_mmap(struct file *file, struct vm_area_struct *vma) {
+    struct simtemp_file *sfile = file->private_data;
+    struct simtemp_dev *sdev = sfile->sdev;
+    struct simtemp_ring_ctrl *ctrl;
+    int ret;
+
+    if (!(vma->vm_flags & VM_SHARED)) {
+        return -EINVAL;
+    }
+
+    switch (vma->vm_pgoff) {
+        case SIMTEMP_MMAP_RING_OFFSET >> PAGE_SHIFT:
+            /* The ring is shared by every consumer, keep it read-only */
+            if (vma->vm_flags & VM_WRITE) {
+                return -EPERM;
+            }
+#if defined(RBPITGT)
+            vma->vm_flags &= ~VM_MAYWRITE;
+#else
+            vm_flags_clear(vma, VM_MAYWRITE);
+#endif
+            /* Mapped rings cannot be resized, see simtemp_resize_ring() */
+            down_read(&sdev->ring_rwsem);
+            ret = remap_vmalloc_range(vma, sdev->ring, 0);
+            if (ret == 0 && !xchg(&sfile->ring_mapped, true)) {
+                atomic_inc(&sdev->ring_mappers);
+                WRITE_ONCE(sfile->consuming, true);
+            }
+            up_read(&sdev->ring_rwsem);
+            return ret;
+
+        case SIMTEMP_MMAP_CTRL_OFFSET >> PAGE_SHIFT:
+            if (!sfile->ctrl) {
+                ctrl = vmalloc_user(PAGE_SIZE);
+                if (!ctrl) {
+                    return -ENOMEM;
+                }
+                /* Start at the current head, only new samples are pending */
+                ctrl->tail = smp_load_acquire(&sdev->head);
+                if (cmpxchg(&sfile->ctrl, NULL, ctrl) != NULL) {
+                    vfree(ctrl);
+                }
+            }
+            return remap_vmalloc_range(vma, sfile->ctrl, 0);
+
+        default:
+            return -EINVAL;
+    }
+}
+
+static const struct file_operations simtemp_fops = {
+    .owner          = THIS_MODULE,
+    .open           = simtemp_open,
+    .release        = simtemp_release,
+    .read_iter      = simtemp_read_iter,
+#if defined(RBPITGT)
+    .splice_read    = generic_file_splice_read,
+#else
+    .splice_read    = copy_splice_read,
+#endif
+    .write          = simtemp_write,
+    .poll           = simtemp_poll,
+    .mmap           = simtemp_mmap,
+    .unlocked_ioctl = simtemp_ioctl,
+};
+
+/* --- Generic netlink --- */
+
+static const struct genl_multicast_group simtemp_nl_groups[] = {
+    [SIMTEMP_NL_GRP_SAMPLES] = { .name = SIMTEMP_NL_GRP_SAMPLES_NAME },
+    [SIMTEMP_NL_GRP_ALERTS] = { .name = SIMTEMP_NL_GRP_ALERTS_NAME },
+};
+
+/* Notifications only, shared by every instance */
+static struct genl_family simtemp_nl_family = {
+    .name = SIMTEMP_NL_FAMILY_NAME,
+    .version = SIMTEMP_NL_VERSION,
+    .maxattr = SIMTEMP_NL_ATTR_MAX,
+    .module = THIS_MODULE,
+    .mcgrps = simtemp_nl_groups,
+    .n_mcgrps = ARRAY_SIZE(simtemp_nl_groups),
+};
+
+/**
+ * @brief Check whether a multicast group has subscribers.
+ * @param group SIMTEMP_NL_GRP_*.
+ * @return true if some socket listens.
+ */
+static bool simtemp_nl_listening(unsigned int group) {
+    return genl_has_listeners(&simtemp_nl_family, &init_net, group);
+}
+
+/**
+ * @brief Multicast the samples published since the last batch.
+ * @param sdev Pointer to simtemp_dev.
+ * @note Called from the netlink work only, which owns sdev->nl_tail. Samples
+ *       are copied straight from the shared history like read() does.
+ */
+static void simtemp_nl_send_samples(struct simtemp_dev *sdev) {
+    const size_t size = sizeof(struct simtemp_sample);
+    struct sk_buff *skb;
+    struct nlattr *attr;
+    void *hdr;
+    u64 head, tail, rewrite_seq, mask, lost = 0;
+    size_t n, first;
+
+    down_read(&sdev->ring_rwsem);
+    mask = sdev->ring_size - 1;
+    while (1) {
+        rewrite_seq = smp_load_acquire(&sdev->ring->rewrite_seq);
+        head = smp_load_acquire(&sdev->ring->head);
+        tail = sdev->nl_tail;
+        if (head - tail > mask) {
+            lost += head - mask - tail;
+            tail = head - mask;
+            sdev->nl_tail = tail;
+        }
+        n = min_t(u64, head - tail, SIMTEMP_NL_BATCH);
+        if (!n) {
+            break;
+        }
+
+        skb = genlmsg_new(nla_total_size(sizeof(u32)) +
+            2 * nla_total_size_64bit(sizeof(u64)) + nla_total_size(n * size),
+            GFP_KERNEL);
+        if (!skb) {
+            break;
+        }
+        hdr = genlmsg_put(skb, 0, 0, &simtemp_nl_family, 0,
+            SIMTEMP_NL_CMD_SAMPLES);
+        if (!hdr ||
+            nla_put_u32(skb, SIMTEMP_NL_ATTR_DEVICE, sdev->index) ||
+            nla_put_u64_64bit(skb, SIMTEMP_NL_ATTR_FIRST_SEQ, tail,
+                SIMTEMP_NL_ATTR_PAD) ||
+            nla_put_u64_64bit(skb, SIMTEMP_NL_ATTR_LOST, lost,
+                SIMTEMP_NL_ATTR_PAD)) {
+            nlmsg_free(skb);
+            break;
+        }
+        attr = nla_reserve(skb, SIMTEMP_NL_ATTR_SAMPLES, n * size);
+        if (!attr) {
+            nlmsg_free(skb);
+            break;
+        }
+
+        first = min_t(size_t, n, mask + 1 - (tail & mask));
+        memcpy(nla_data(attr), &sdev->ring_data[tail & mask], first * size);
+        memcpy(nla_data(attr) + first * size, sdev->ring_data,
+            (n - first) * size);
+        smp_rmb();
+        if (READ_ONCE(sdev->ring->head) - tail > mask || (rewrite_seq & 1) ||
+            READ_ONCE(sdev->ring->rewrite_seq) != rewrite_seq) {
+            nlmsg_free(skb);
+            continue;  // Lapped or rewritten while copying
+        }
+
+        genlmsg_end(skb, hdr);
+        sdev->nl_tail = tail + n;
+        lost = 0;
+        /* Fails with -ESRCH once the last subscriber left, nothing to do */
+        genlmsg_multicast(&simtemp_nl_family, skb, 0, SIMTEMP_NL_GRP_SAMPLES,
+            GFP_KERNEL);
+    }
+    up_read(&sdev->ring_rwsem);
+}
+
+/**
+ * @brief Multicast the alerts raised since the last run.
+ * @param sdev Pointer to simtemp_dev.
+ * @note Called from the netlink work only, which owns sdev->nl_alert_tail.
+ */
+static void simtemp_nl_send_alerts(struct simtemp_dev *sdev) {
+    struct simtemp_alert alert;
+    struct sk_buff *skb;
+    void *hdr;
+
+    while (!simtemp_alert_copy(sdev, &sdev->nl_alert_tail, &alert)) {
+        skb = genlmsg_new(nla_total_size(sizeof(u32)) +
+            nla_total_size(sizeof(alert)), GFP_KERNEL);
+        if (!skb) {
+            return;
+        }
+        hdr = genlmsg_put(skb, 0, 0, &simtemp_nl_family, 0,
+            SIMTEMP_NL_CMD_ALERT);
+        if (!hdr ||
+            nla_put_u32(skb, SIMTEMP_NL_ATTR_DEVICE, sdev->index) ||
+            nla_put(skb, SIMTEMP_NL_ATTR_ALERT, sizeof(alert), &alert)) {
+            nlmsg_free(skb);
+            return;
+        }
+        genlmsg_end(skb, hdr);
+        genlmsg_multicast(&simtemp_nl_family, skb, 0, SIMTEMP_NL_GRP_ALERTS,
+            GFP_KERNEL);
+    }
+}
+
+/**
+ * @brief Publish everything produced since the last run to netlink.
+ * @param work Pointer to the simtemp_dev nl_work.
+ * @note Queued by the producer, so one run batches every sample of the
+ *       ticks that happened meanwhile. Groups without subscribers just move
+ *       their cursor, so subscribers only get what comes after they joined.
+ */
+static void simtemp_nl_work(struct work_struct *work) {
+    struct simtemp_dev *sdev = container_of(work, struct simtemp_dev,
+        nl_work);
+
+    if (simtemp_nl_listening(SIMTEMP_NL_GRP_SAMPLES)) {
+        simtemp_nl_send_samples(sdev);
+    } else {
+        sdev->nl_tail = smp_load_acquire(&sdev->head);
+    }
+
+    if (simtemp_nl_listening(SIMTEMP_NL_GRP_ALERTS)) {
+        simtemp_nl_send_alerts(sdev);
+    } else {
+        sdev->nl_alert_tail = smp_load_acquire(&sdev->alert_head);
+    }
+}
+
+/**
+ * @brief Publish a sample into the shared mmap() ring.
+ * @param sdev Pointer to simtemp_dev.
+ * @param sample Sample to publish.
+ * @return Sequence number of the published sample.
+ * @note Single producer, readers synchronize on the head only.
+ */
+static u64 simtemp_ring_publish(struct simtemp_dev *sdev,
+    const struct simtemp_sample *sample) {
+    u64 head = sdev->ring->head;
+
+    /* Order the previous head update before overwriting an old slot */
+    smp_wmb();
+    sdev->ring_data[head & (sdev->ring_size - 1)] = *sample;
+    /* Make the slot visible before the new head */
+    smp_store_release(&sdev->ring->head, head + 1);
+    smp_store_release(&sdev->head, head + 1);
+
+    return head;
+}
+
+/**
+ * @brief Replace the newest published sample without moving the head.
+ * @param sdev Pointer to simtemp_dev.
+ * @param sample Sample to store.
+ * @return Sequence number of the rewritten sample.
+ * @note Single producer, readers retry while rewrite_seq is odd or changed.
+ */
+static u64 simtemp_ring_rewrite(struct simtemp_dev *sdev,
+    const struct simtemp_sample *sample) {
+    u64 seq = sdev->ring->head - 1;
+
+    WRITE_ONCE(sdev->ring->rewrite_seq, sdev->ring->rewrite_seq + 1);
+    smp_wmb();
+    sdev->ring_data[seq & (sdev->ring_size - 1)] = *sample;
+    smp_store_release(&sdev->ring->rewrite_seq, sdev->ring->rewrite_seq + 1);
+
+    return seq;
+}
+
+/**
+ * @brief Check whether publishing would overrun the slowest consumer.
+ * @param sdev Pointer to simtemp_dev.
+ * @return true if some consuming file has ring_size - 1 unread samples.
+ * @note Walks the open files under RCU, only used by non default policies.
+ *       Files that never read() nor mapped the ring, e.g. ioctl-only
+ *       clients, don't hold the producer back.
+ */
+static bool simtemp_ring_full(struct simtemp_dev *sdev) {
+    struct simtemp_file *sfile;
+    u64 head = sdev->ring->head;
+    u64 tail;
+    bool full = false;
+
+    rcu_read_lock();
+    list_for_each_entry_rcu(sfile, &sdev->readers, node) {
+        if (!READ_ONCE(sfile->consuming)) {
+            continue;
+        }
+        tail = simtemp_file_tail(sfile);
+        if (head - tail >= sdev->ring_size - 1) {
+            full = true;
+            break;
+        }
+    }
+    rcu_read_unlock();
+
+    return full;
+}
+
+/**
+ * @brief Queue a threshold transition for every open file.
+ * @param sdev Pointer to simtemp_dev.
+ * @param sample Sample that crossed.
+ * @param threshold_mC Threshold the sample was compared with.
+ * @param type SIMTEMP_ALERT_*.
+ * @note Producer only. Files that fall ALERT_DEPTH alerts behind lose the
+ *       oldest ones.
+ */
+static void simtemp_alert_push(struct simtemp_dev *sdev,
+    const struct simtemp_sample *sample, u32 threshold_mC, u32 type) {
+    struct simtemp_alert *alert =
+        &sdev->alerts[sdev->alert_head & (ALERT_DEPTH - 1)];
+
+    alert->timestamp_ns = sample->timestamp_ns;
+    alert->temp_mC = sample->temp_mC;
+    alert->type = type;
+    alert->threshold_mC = threshold_mC;
+    alert->lost = 0;
+    /* Publish the alert before the new head */
+    smp_store_release(&sdev->alert_head, sdev->alert_head + 1);
+    trace_threshold_crossed(sdev->index, sample->temp_mC, threshold_mC,
+        type == SIMTEMP_ALERT_RISING);
+}
+
+/**
+ * @brief Publish a sample, checking it against the threshold.
+ * @param sdev Pointer to simtemp_dev.
+ * @param timestamp_ns Sample timestamp.
+ * @param temp_mC Sample temperature.
+ * @return Poll events the sample raises.
+ * @note Only called from the single producer, the generator.
+ */
+static __poll_t simtemp_emit_sample(struct simtemp_dev *sdev, u64 timestamp_ns,
+    u32 temp_mC) {
+    struct simtemp_sample sample;
+    __poll_t mask = POLLIN;
+    u64 seq;
+    u32 threshold_mC = READ_ONCE(sdev->threshold_mC);
+    u32 hysteresis_mC = READ_ONCE(sdev->hysteresis_mC);
+    u16 flags = sdev->current_flags | NEW_SAMPLE;
+
+    /*
+     * The producer is the only writer of the generator state, other
+     * contexts read it locklessly.
+     */
+    sample.timestamp_ns = timestamp_ns;
+    sample.temp_mC = temp_mC;
+    WRITE_ONCE(sdev->current_temp, sample.temp_mC);
+    WRITE_ONCE(sdev->samples_taken, sdev->samples_taken + 1);
+
+    /*
+     * Alert on transitions only: the state rises at threshold_mC and only
+     * falls again below threshold_mC - hysteresis_mC, so readings hovering
+     * around the threshold do not raise a storm of alerts.
+     */
+    if (!sdev->alert_active && sample.temp_mC >= threshold_mC) {
+        sdev->alert_active = true;
+        WRITE_ONCE(sdev->threshold_alerts, sdev->threshold_alerts + 1);
+        simtemp_alert_push(sdev, &sample, threshold_mC, SIMTEMP_ALERT_RISING);
+        /* Set flag to wake up pollers for urgent data (threshold crossing) */
+        mask |= POLLPRI;
+    } else if (sdev->alert_active &&
+        (u64)sample.temp_mC + hysteresis_mC < threshold_mC) {
+        sdev->alert_active = false;
+        simtemp_alert_push(sdev, &sample, threshold_mC, SIMTEMP_ALERT_FALLING);
+        mask |= POLLPRI;
+    }
+
+    /* THRESHOLD_CROSSED follows the hysteresis state */
+    if (sdev->alert_active) {
+        flags |= THRESHOLD_CROSSED;
+    } else { /* Clean flags */
+        flags &= ~THRESHOLD_CROSSED;
+    }
+
+    WRITE_ONCE(sdev->current_flags, flags);
+    sample.flags = flags;
+    simtemp_aggregate(sdev, &sample);
+
+    /* Update the shared history according to the overflow policy */
+    switch (READ_ONCE(sdev->overflow_policy)) {
+        case OVERFLOW_DROP_NEWEST:
+            if (simtemp_ring_full(sdev)) {
+                WRITE_ONCE(sdev->dropped_newest, sdev->dropped_newest + 1);
+                simtemp_stat_add(sdev, SIMTEMP_STAT_SAMPLES_DROPPED, 1);
+                trace_sample_dropped(sdev->index, sdev->ring->head, 1);
+                sdev->gap_pending = true;
+                /* Nothing new to read, live alerts still apply */
+                return mask & ~POLLIN;
+            }
+            break;
+        case OVERFLOW_OVERWRITE:
+            if (simtemp_ring_full(sdev)) {
+                WRITE_ONCE(sdev->overwritten, sdev->overwritten + 1);
+                simtemp_stat_add(sdev, SIMTEMP_STAT_SAMPLES_DROPPED, 1);
+                trace_sample_dropped(sdev->index, sdev->ring->head - 1, 1);
+                sample.flags |= DATA_GAP;
+                seq = simtemp_ring_rewrite(sdev, &sample);
+                trace_sample_produced(sdev->index, seq, &sample);
+                return mask;
+            }
+            break;
+        default:
+            /* Lagging readers account their overruns */
+            break;
+    }
+
+    if (sdev->gap_pending) {
+        sample.flags |= DATA_GAP;
+        sdev->gap_pending = false;
+    }
+    seq = simtemp_ring_publish(sdev, &sample);
+    trace_sample_produced(sdev->index, seq, &sample);
+
+    return mask;
+}
+
+/**
+ * @brief Take one simulated sample and publish it.
+ * @param sdev Pointer to simtemp_dev.
+ * @param timestamp_ns Sample timestamp.
+ * @return Poll events the sample raises.
+ */
+static __poll_t simtemp_take_sample(struct simtemp_dev *sdev, u64 timestamp_ns) {
+    return simtemp_emit_sample(sdev, timestamp_ns, get_temperature(sdev));
+}
+
+/**
+ * @brief Publish the queued replay records that are due.
+ * @param sdev Pointer to simtemp_dev.
+ * @return Poll events the records raise.
+ * @note Records keep their original spacing divided by replay_speed and are
+ *       stamped with their playback time. Running out of records restarts
+ *       the timing with the next one.
+ */
+static __poll_t simtemp_replay_tick(struct simtemp_dev *sdev) {
+    struct simtemp_sample rec;
+    __poll_t mask = 0;
+    u32 speed = READ_ONCE(sdev->replay_speed);
+    u32 budget = sdev->ring_size - 1;
+    u64 now_ns = ktime_get_ns();
+    u64 clock_ns = simtemp_clock_ns(sdev);
+    u64 due_ns, offset_ns;
+    bool popped = false;
+
+    /* Never publish more than a reader can hold in one tick */
+    while (budget-- && kfifo_peek(&sdev->replay, &rec)) {
+        if (!sdev->replay_running) {
+            sdev->replay_running = true;
+            sdev->replay_base_ns = now_ns;
+            sdev->replay_base_ts = rec.timestamp_ns;
+        }
+
+        due_ns = now_ns;
+        if (speed) {
+            offset_ns = rec.timestamp_ns > sdev->replay_base_ts ?
+                rec.timestamp_ns - sdev->replay_base_ts : 0;
+            due_ns = sdev->replay_base_ns + div_u64(offset_ns, speed);
+            if (due_ns > now_ns) {
+                break;
+            }
+        }
+
+        kfifo_skip(&sdev->replay);
+        popped = true;
+        WRITE_ONCE(sdev->replayed, sdev->replayed + 1);
+        mask |= simtemp_emit_sample(sdev, clock_ns - (now_ns - due_ns),
+            rec.temp_mC);
+    }
+
+    if (kfifo_is_empty(&sdev->replay)) {
+        sdev->replay_running = false;
+    }
+    if (popped && wq_has_sleeper(&sdev->replay_wait)) {
+        wake_up_interruptible_poll(&sdev->replay_wait, POLLOUT | POLLWRNORM);
+    }
+
+    return mask;
+}
+
+/**
+ * @brief Wake up the files whose wakeup condition is met.
+ * @param sdev Pointer to simtemp_dev.
+ * @param mask Poll events raised by the samples of this tick.
+ * @note Producer only. Files below their watermark are left asleep, with
+ *       their deadline armed if they set max_latency_ns.
+ */
+static void simtemp_wake_readers(struct simtemp_dev *sdev, __poll_t mask) {
+    struct simtemp_file *sfile;
+    __poll_t key;
+    unsigned long flags;
+    u64 head = sdev->head;
+    u64 max_latency_ns, tail;
+
+    rcu_read_lock();
+    list_for_each_entry_rcu(sfile, &sdev->readers, node) {
+        /* Only take the wait queue lock when somebody is waiting */
+        if (!wq_has_sleeper(&sfile->wait)) {
+            continue;
+        }
+
+        /* Alerts never wait for the watermark */
+        key = mask & POLLPRI;
+        if ((mask & POLLIN) && simtemp_file_ready(sfile, head)) {
+            key |= POLLIN | POLLRDNORM;
+        } else if (mask & POLLIN) {
+            tail = simtemp_file_tail(sfile);
+            max_latency_ns = READ_ONCE(sfile->max_latency_ns);
+            if (max_latency_ns && head != tail &&
+                !hrtimer_is_queued(&sfile->deadline)) {
+                /* release() marks the file under this lock, then cancels */
+                spin_lock_irqsave(&sfile->wait.lock, flags);
+                if (!sfile->released) {
+                    hrtimer_start(&sfile->deadline,
+                        ns_to_ktime(max_latency_ns), HRTIMER_MODE_REL);
+                }
+                spin_unlock_irqrestore(&sfile->wait.lock, flags);
+            }
+        }
+
+        if (key) {
+            wake_up_interruptible_poll(&sfile->wait, key);
+            simtemp_stat_add(sdev, SIMTEMP_STAT_WAKEUPS, 1);
+        }
+    }
+    rcu_read_unlock();
+}
+
+/**
+ * @brief Produce the samples of one generator tick and wake up readers.
+ * @param sdev Pointer to simtemp_dev.
+ * @return Time until the next tick.
+ * @note Called from the single active generator context.
+ */
+static ktime_t simtemp_generate_tick(struct simtemp_dev *sdev) {
+    __poll_t mask = 0;
+    ktime_t tick_period;
+    u64 sampling_ns, now_ns;
+    u32 samples_per_tick, i;
+    unsigned int seq;
+
+
+    /* Lockless snapshot of the sampling period, updates are rare */
+    do {
+        seq = read_seqcount_begin(&sdev->period_seq);
+        sampling_ns = sdev->sampling_ns;
+        samples_per_tick = sdev->samples_per_tick;
+        tick_period = sdev->tick_period;
+    } while (read_seqcount_retry(&sdev->period_seq, seq));
+
+    /* Stamp the samples with the clock the device was configured with */
+    now_ns = simtemp_clock_ns(sdev);
+
+    if (READ_ONCE(sdev->mode) == MODE_REPLAY) {
+        mask = simtemp_replay_tick(sdev);
+    } else {
+        /* Spread the samples of this tick over the elapsed sampling periods */
+        for (i = 0; i < samples_per_tick; i++) {
+            mask |= simtemp_take_sample(sdev, now_ns -
+                (u64)(samples_per_tick - 1 - i) * sampling_ns);
+        }
+    }
+
+    if (mask) {
+        simtemp_wake_readers(sdev, mask);
+        /* Netlink subscribers get their batches from process context */
+        if (simtemp_nl_listening(SIMTEMP_NL_GRP_SAMPLES) ||
+            ((mask & POLLPRI) && simtemp_nl_listening(SIMTEMP_NL_GRP_ALERTS))) {
+            schedule_work(&sdev->nl_work);
+        }
+        /* So does the IIO buffer, through the trigger of the device */
+        if ((mask & POLLIN) && simtemp_iio_buffering(sdev)) {
+            schedule_work(&sdev->iio_work);
+        }
+    }
+
+    return tick_period;
+}
+
+/**
+ * @brief High-resolution timer function that will be executed periodically.
+ * @param timer Pointer to hrtimer struct.
+ * @return A timer restart value HRTIMER_RESTART
+ */
+static enum hrtimer_restart simtemp_hrtimer_callback(struct hrtimer *timer) {
+    struct simtemp_dev *sdev = container_of(timer, struct simtemp_dev,
+        temp_hrtimer);
+    ktime_t tick_period, expires, now;
+    u64 overruns;
+
+    expires = hrtimer_get_expires(timer);
+    now = ktime_get();
+
+    tick_period = simtemp_generate_tick(sdev);
+
+    /* Restart the timer, every overrun beyond the first is a missed period */
+    overruns = hrtimer_forward_now(timer, tick_period);
+    simtemp_jitter_record(sdev, expires, now, overruns ? overruns - 1 : 0);
+    return HRTIMER_RESTART;
+}
+
+/**
+ * @brief Generator thread for GEN_CTX_KTHREAD.
+ * @param data Pointer to simtemp_dev.
+ * @return 0 when stopped.
+ */
+static int simtemp_kthread_fn(void *data) {
+    struct simtemp_dev *sdev = data;
+    ktime_t tick_period = READ_ONCE(sdev->tick_period);
+    ktime_t next, now, done, expires;
+    u64 missed;
+
+    next = ktime_add(ktime_get(), tick_period);
+    while (1) {
+        /*
+         * Sleep until the absolute expiry, kthread_stop() wakes us up. Set the
+         * state before checking for a stop so its wakeup can't be lost.
+         */
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (kthread_should_stop()) {
+            __set_current_state(TASK_RUNNING);
+            break;
+        }
+        schedule_hrtimeout(&next, HRTIMER_MODE_ABS);
+        if (kthread_should_stop()) {
+            break;
+        }
+        expires = next;
+        now = ktime_get();
+
+        tick_period = simtemp_generate_tick(sdev);
+
+        /* Skip the periods already missed, as hrtimer_forward_now() does */
+        missed = 0;
+        next = ktime_add(next, tick_period);
+        done = ktime_get();
+        if (ktime_compare(next, done) <= 0) {
+            missed = div64_u64(ktime_to_ns(ktime_sub(done, next)),
+                ktime_to_ns(tick_period)) + 1;
+            next = ktime_add_ns(next, missed * ktime_to_ns(tick_period));
+        }
+        simtemp_jitter_record(sdev, expires, now, missed);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Start producing samples in the configured execution context.
+ * @param sdev Pointer to simtemp_dev.
+ * @return 0 on success, different than 0 otherwise.
+ * @note Called with sdev->gen_lock held and the generator stopped.
+ */
+static int simtemp_start_generator(struct simtemp_dev *sdev) {
+    struct task_struct *task;
+    enum hrtimer_mode mode;
+    ktime_t tick_period = READ_ONCE(sdev->tick_period);
+
+    switch (sdev->gen_context) {
+        case GEN_CTX_KTHREAD:
+            task = kthread_create(simtemp_kthread_fn, sdev, "%s-gen",
+                sdev->name);
+            if (IS_ERR(task)) {
+                return PTR_ERR(task);
+            }
+            if (sdev->gen_cpu >= 0) {
+                kthread_bind(task, sdev->gen_cpu);
+            }
+#if defined(RBPITGT)
+            {
+                struct sched_param param = {
+                    .sched_priority = MAX_RT_PRIO / 2,
+                };
+                sched_setscheduler_nocheck(task, SCHED_FIFO, &param);
+            }
+#else
+            sched_set_fifo(task);
+#endif
+            sdev->gen_thread = task;
+            wake_up_process(task);
+            break;
+
+        default:
+            /* Expire in hardirq or, with the _SOFT mode, softirq context */
+            mode = (sdev->gen_context == GEN_CTX_SOFTIRQ) ?
+                HRTIMER_MODE_REL_SOFT : HRTIMER_MODE_REL;
+            hrtimer_init(&sdev->temp_hrtimer, CLOCK_MONOTONIC, mode);
+            sdev->temp_hrtimer.function = &simtemp_hrtimer_callback;
+            hrtimer_start(&sdev->temp_hrtimer, tick_period, mode);
+            break;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stop producing samples, waiting for a running tick to finish.
+ * @param sdev Pointer to simtemp_dev.
+ * @note Called with sdev->gen_lock held.
+ */
+static void simtemp_stop_generator(struct simtemp_dev *sdev) {
+    if (sdev->gen_thread) {
+        kthread_stop(sdev->gen_thread);
+        sdev->gen_thread = NULL;
+    }
+    hrtimer_cancel(&sdev->temp_hrtimer);
+}
+
+/* --- Debugfs --- */
+
+/**
+ * @brief Print a log2-bucketed histogram, skipping empty buckets.
+ * @param m Pointer to seq_file.
+ * @param hist Pointer to simtemp_hist.
+ */
+static void simtemp_hist_show(struct seq_file *m,
+    const struct simtemp_hist *hist) {
+    u64 count = READ_ONCE(hist->count);
+    u64 n;
+    u32 i;
+
+    seq_printf(m, "count: %llu\n", count);
+    seq_printf(m, "mean_ns: %llu\n",
+        count ? div64_u64(READ_ONCE(hist->sum_ns), count) : 0);
+    seq_printf(m, "max_ns: %llu\n", READ_ONCE(hist->max_ns));
+
+    /* Bucket i holds values in [2^(i-1), 2^i), bucket 0 holds zero */
+    for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++) {
+        n = READ_ONCE(hist->buckets[i]);
+        if (!n) {
+            continue;
+        }
+        if (i == SIMTEMP_HIST_BUCKETS - 1) {
+            seq_printf(m, "%12llu ... %12s: %llu\n", 1ULL << (i - 1), "",
+                n);
+        } else {
+            seq_printf(m, "%12llu ... %12llu: %llu\n",
+                i ? 1ULL << (i - 1) : 0, i ? (1ULL << i) - 1 : 0, n);
+        }
+    }
+}
+
+static int simtemp_jitter_show(struct seq_file *m, void *v) {
+    struct simtemp_dev *sdev = m->private;
+
+    seq_printf(m, "period_ns: %lld\n",
+        ktime_to_ns(READ_ONCE(sdev->tick_period)));
+    seq_printf(m, "missed_periods: %llu\n", READ_ONCE(sdev->missed_periods));
+    seq_puts(m, "lateness:\n");
+    simtemp_hist_show(m, &sdev->jitter);
+
+    return 0;
+}
+
+static int simtemp_jitter_open(struct inode *inode, struct file *file) {
+    return single_open(file, simtemp_jitter_show, inode->i_private);
+}
+
+/**
+ * @brief Any write to the jitter file resets the histogram.
+ */
+static ssize_t simtemp_jitter_write(struct file *file, const char __user *buf,
+    size_t count, loff_t *ppos) {
+    struct simtemp_dev *sdev = ((struct seq_file *)file->private_data)->private;
+
+    WRITE_ONCE(sdev->jitter_reset, true);
+
+    return count;
+}
+
+static const struct file_operations simtemp_jitter_fops = {
+    .owner = THIS_MODULE,
+    .open = simtemp_jitter_open,
+    .read = seq_read,
+    .write = simtemp_jitter_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static int simtemp_latency_show(struct seq_file *m, void *v) {
+    struct simtemp_dev *sdev = m->private;
+    struct simtemp_hist *hist;
+    struct simtemp_latency lat;
+
+    /* Snapshot under the lock so the percentiles match the buckets */
+    hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+    if (!hist) {
+        return -ENOMEM;
+    }
+    spin_lock(&sdev->latency_lock);
+    *hist = sdev->latency;
+    spin_unlock(&sdev->latency_lock);
+
+    simtemp_hist_to_latency(hist, &lat);
+    seq_printf(m, "p50_ns: %llu\n", lat.p50_ns);
+    seq_printf(m, "p90_ns: %llu\n", lat.p90_ns);
+    seq_printf(m, "p99_ns: %llu\n", lat.p99_ns);
+    seq_printf(m, "p99.9_ns: %llu\n", lat.p999_ns);
+    seq_puts(m, "delivery latency:\n");
+    simtemp_hist_show(m, hist);
+    kfree(hist);
+
+    return 0;
+}
+
+static int simtemp_latency_open(struct inode *inode, struct file *file) {
+    return single_open(file, simtemp_latency_show, inode->i_private);
+}
+
+/**
+ * @brief Any write to the latency file resets the device histogram.
+ */
+static ssize_t simtemp_latency_write(struct file *file,
+    const char __user *buf, size_t count, loff_t *ppos) {
+    struct simtemp_dev *sdev = ((struct seq_file *)file->private_data)->private;
+
+    spin_lock(&sdev->latency_lock);
+    memset(&sdev->latency, 0, sizeof(sdev->latency));
+    spin_unlock(&sdev->latency_lock);
+
+    return count;
+}
+
+static const struct file_operations simtemp_latency_fops = {
+    .owner = THIS_MODULE,
+    .open = simtemp_latency_open,
+    .read = seq_read,
+    .write = simtemp_latency_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/**
+ * @brief Create /sys/kernel/debug/simtemp/<name>/ for an instance.
+ * @param sdev Pointer to simtemp_dev.
+ * @note Debugfs failures are not fatal, the files are diagnostics only.
+ */
+static void simtemp_debugfs_init(struct simtemp_dev *sdev) {
+    sdev->debugfs = debugfs_create_dir(sdev->name, simtemp_debugfs_root);
+    debugfs_create_file("jitter", 0600, sdev->debugfs, sdev,
+        &simtemp_jitter_fops);
+    debugfs_create_file("latency", 0600, sdev->debugfs, sdev,
+        &simtemp_latency_fops);
+}
+
+/* --- Industrial I/O front-end --- */
+#if IS_REACHABLE(CONFIG_IIO_TRIGGERED_BUFFER)
+
+/* in_temp_raw in millidegrees Celsius, plus the soft timestamp in scans */
+static const struct iio_chan_spec simtemp_iio_channels[] = {
+    {
+        .type = IIO_TEMP,
+        .info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |
+            BIT(IIO_CHAN_INFO_SCALE),
+        .scan_index = 0,
+        .scan_type = {
+            .sign = 'u',
+            .realbits = 32,
+            .storagebits = 32,
+            .endianness = IIO_CPU,
+        },
+    },
+    IIO_CHAN_SOFT_TIMESTAMP(1),
+};
+
+static int simtemp_iio_read_raw(struct iio_dev *indio_dev,
+    struct iio_chan_spec const *chan, int *val, int *val2, long mask) {
+    struct simtemp_dev *sdev = *(struct simtemp_dev **)iio_priv(indio_dev);
+
+    switch (mask) {
+        case IIO_CHAN_INFO_RAW:
+            *val = READ_ONCE(sdev->current_temp);
+            return IIO_VAL_INT;
+        case IIO_CHAN_INFO_SCALE:
+            /* Samples already are in the IIO unit, millidegrees Celsius */
+            *val = 1;
+            return IIO_VAL_INT;
+        default:
+            return -EINVAL;
+    }
+}
+
+static const struct iio_info simtemp_iio_info = {
+    .read_raw = simtemp_iio_read_raw,
+};
+
+/**
+ * @brief Push every sample produced since the last run into the IIO buffer.
+ * @param irq Trigger interrupt.
+ * @param p Pointer to the iio_poll_func of the buffer.
+ * @return IRQ_HANDLED.
+ * @note Owns sdev->iio_tail. Samples are copied from the shared history like
+ *       the netlink work does, so however often a trigger fires, each one is
+ *       pushed once, with its own timestamp.
+ */
+static irqreturn_t simtemp_iio_trigger_handler(int irq, void *p) {
+    struct iio_poll_func *pf = p;
+    struct iio_dev *indio_dev = pf->indio_dev;
+    struct simtemp_dev *sdev = *(struct simtemp_dev **)iio_priv(indio_dev);
+    struct simtemp_sample sample;
+    struct {
+        u32 temp;
+        s64 timestamp __aligned(8);
+    } scan;
+    u64 head, tail, rewrite_seq, mask;
+
+    memset(&scan, 0, sizeof(scan));
+    down_read(&sdev->ring_rwsem);
+    mask = sdev->ring_size - 1;
+    while (1) {
+        rewrite_seq = smp_load_acquire(&sdev->ring->rewrite_seq);
+        head = smp_load_acquire(&sdev->ring->head);
+        tail = sdev->iio_tail;
+        /* Skip what the producer already overwrote */
+        if (head - tail > mask) {
+            tail = head - mask;
+        }
+        if (tail == head) {
+            break;
+        }
+
+        sample = sdev->ring_data[tail & mask];
+        smp_rmb();
+        if (READ_ONCE(sdev->ring->head) - tail > mask || (rewrite_seq & 1) ||
+            READ_ONCE(sdev->ring->rewrite_seq) != rewrite_seq) {
+            continue;  // Lapped or rewritten while copying
+        }
+
+        sdev->iio_tail = tail + 1;
+        scan.temp = sample.temp_mC;
+        iio_push_to_buffers_with_timestamp(indio_dev, &scan,
+            sample.timestamp_ns);
+    }
+    up_read(&sdev->ring_rwsem);
+    iio_trigger_notify_done(indio_dev->trig);
+
+    return IRQ_HANDLED;
+}
 
-    return scnprintf(buf, PAGE_SIZE, "samples_taken: %llu\nthreshold_alerts:"
-        " %llu\n", samples_taken, threshold_alerts);
+/**
+ * @brief Start an enabled buffer with the samples produced from now on.
+ * @param indio_dev Pointer to the iio_dev of an instance.
+ * @return 0.
+ */
+static int simtemp_iio_preenable(struct iio_dev *indio_dev) {
+    struct simtemp_dev *sdev = *(struct simtemp_dev **)iio_priv(indio_dev);
+
+    sdev->iio_tail = smp_load_acquire(&sdev->head);
+    return 0;
 }
-static DEVICE_ATTR_RO(stats);
 
-static struct attribute *simtemp_attrs[] = {
-    &dev_attr_sampling_ms.attr,
-    &dev_attr_threshold_mC.attr,
-    &dev_attr_mode.attr,
-    &dev_attr_stats.attr,
-    NULL,
+static const struct iio_buffer_setup_ops simtemp_iio_buffer_ops = {
+    .preenable = simtemp_iio_preenable,
+#if defined(RBPITGT)
+    /* Older cores leave attaching the poll function to the driver */
+    .postenable = iio_triggered_buffer_postenable,
+    .predisable = iio_triggered_buffer_predisable,
+#endif
 };
 
-static const struct attribute_group simtemp_group = {
-    .attrs = simtemp_attrs,
-};
+/**
+ * @brief Check whether the IIO buffer of an instance wants samples.
+ * @param sdev Pointer to simtemp_dev.
+ * @return true while the buffer is enabled.
+ */
+static bool simtemp_iio_buffering(struct simtemp_dev *sdev) {
+    struct iio_dev *indio_dev = READ_ONCE(sdev->indio_dev);
 
-/* --- Char Device File Operations --- */
-static int simtemp_open(struct inode *inode, struct file *file) {
-    file->private_data = simtemp_data;
-    dev_info(simtemp_data->dev, "Device opened.\n");
-    return 0;
+    return indio_dev && iio_buffer_enabled(indio_dev);
 }
 
-static int simtemp_release(struct inode *inode, struct file *file) {
-    struct simtemp_dev *sdev = file->private_data;
-    dev_info(sdev->dev, "Device released.\n");
-    return 0;
+/**
+ * @brief Fire the trigger of an instance for the samples of the last ticks.
+ * @param work Pointer to the simtemp_dev iio_work.
+ * @note Queued by the producer. The trigger handler runs right here, in
+ *       process context, and drains everything produced meanwhile.
+ */
+static void simtemp_iio_work(struct work_struct *work) {
+    struct simtemp_dev *sdev = container_of(work, struct simtemp_dev,
+        iio_work);
+
+#if defined(RBPITGT)
+    iio_trigger_poll_chained(sdev->iio_trig);
+#else
+    iio_trigger_poll_nested(sdev->iio_trig);
+#endif
 }
 
-static ssize_t simtemp_read(struct file *file, char __user *buf, size_t count,
-    loff_t *ppos) {
-    struct simtemp_dev *sdev = file->private_data;
-    struct simtemp_sample sample;
+/**
+ * @brief Register the IIO device of an instance, next to its misc device.
+ * @param sdev Pointer to simtemp_dev.
+ * @return 0 on success, different than 0 otherwise.
+ * @note The buffer defaults to the "<name>-sample" trigger, fired once per
+ *       producer tick. Any other trigger works as well, it only sets the
+ *       pace samples are pushed at.
+ */
+static int simtemp_iio_register(struct simtemp_dev *sdev) {
+    struct iio_dev *indio_dev;
+    struct iio_trigger *trig;
     int ret;
-    int copied;
-    unsigned long flags;
 
-
-    if (count < sizeof(sample)) {
-        return -EINVAL;
+    indio_dev = devm_iio_device_alloc(sdev->dev, sizeof(sdev));
+    if (!indio_dev) {
+        return -ENOMEM;
     }
+    *(struct simtemp_dev **)iio_priv(indio_dev) = sdev;
 
-    if (kfifo_is_empty(&sdev->kfifo)) {
-        if (file->f_flags & O_NONBLOCK) {
-            return -EAGAIN;
-        }
+#if defined(RBPITGT)
+    indio_dev->dev.parent = sdev->dev;
+#endif
+    indio_dev->name = sdev->name;
+    indio_dev->info = &simtemp_iio_info;
+    indio_dev->modes = INDIO_DIRECT_MODE;
+    indio_dev->channels = simtemp_iio_channels;
+    indio_dev->num_channels = ARRAY_SIZE(simtemp_iio_channels);
 
-        /* Wait for data with exclusive wake-up */
-        ret = wait_event_interruptible_exclusive(sdev->read_wait,
-            kfifo_is_empty(&sdev->kfifo) == 0);
-        if (ret) {
-            return ret;  // Signal received
-        }
+    trig = devm_iio_trigger_alloc(sdev->dev, "%s-sample", sdev->name);
+    if (!trig) {
+        return -ENOMEM;
     }
+#if defined(RBPITGT)
+    trig->dev.parent = sdev->dev;
+#endif
+    ret = devm_iio_trigger_register(sdev->dev, trig);
+    if (ret) {
+        return ret;
+    }
+    sdev->iio_trig = trig;
+    indio_dev->trig = iio_trigger_get(trig);
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    ret = kfifo_get(&sdev->kfifo, &sample);
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
-    if (ret == 0) { /* Should not happen if wait_event worked */
-        return -EAGAIN;
+    /* Scans carry the sample timestamps, no top half needed */
+    ret = iio_triggered_buffer_setup(indio_dev, NULL,
+        simtemp_iio_trigger_handler, &simtemp_iio_buffer_ops);
+    if (ret) {
+        return ret;
     }
 
-    copied = min_t(size_t, count, sizeof(sample));
-    if (copy_to_user(buf, &sample, copied)) {
-        return -EFAULT;
+    ret = iio_device_register(indio_dev);
+    if (ret) {
+        iio_triggered_buffer_cleanup(indio_dev);
+        return ret;
     }
+    WRITE_ONCE(sdev->indio_dev, indio_dev);
 
-    return copied;
+    return 0;
 }
 
-static __poll_t simtemp_poll(struct file *file,
-    struct poll_table_struct *wait) {
-    __poll_t mask = 0;
-    struct simtemp_dev *sdev = file->private_data;
-    unsigned long flags;
+/**
+ * @brief Unregister the IIO device of an instance.
+ * @param sdev Pointer to simtemp_dev.
+ */
+static void simtemp_iio_unregister(struct simtemp_dev *sdev) {
+    iio_device_unregister(sdev->indio_dev);
+    iio_triggered_buffer_cleanup(sdev->indio_dev);
+}
 
-    poll_wait(file, &sdev->poll_wait, wait);
+#else
 
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-    if (!kfifo_is_empty(&sdev->kfifo)) {
-        mask |= POLLIN | POLLRDNORM;
-    }
-    if (sdev->current_flags & THRESHOLD_CROSSED) {
-        mask |= POLLPRI;
-    }
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+static bool simtemp_iio_buffering(struct simtemp_dev *sdev) {
+    return false;
+}
 
-    return mask;
+static void simtemp_iio_work(struct work_struct *work) {
 }
 
-static long simtemp_ioctl(struct file *file, unsigned int cmd,
-    unsigned long arg) {
-    struct simtemp_dev *sdev = file->private_data;
-    struct simtemp_config cfg;
-    int err = 0;
-    unsigned long flags;
+static int simtemp_iio_register(struct simtemp_dev *sdev) {
+    return 0;
+}
 
+static void simtemp_iio_unregister(struct simtemp_dev *sdev) {
+}
 
-    if (_IOC_TYPE(cmd) != SIMTEMP_IOC_MAGIC)
-        return -ENOTTY;
+#endif
 
-    switch (cmd) {
-        case SIMTEMP_IOC_SET_ALL:
-            if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg))) {
-                return -EFAULT;
-            }
+/* --- Hardware monitoring front-end --- */
+#if IS_REACHABLE(CONFIG_HWMON)
+
+static umode_t simtemp_hwmon_is_visible(const void *data,
+    enum hwmon_sensor_types type, u32 attr, int channel) {
+    switch (attr) {
+        case hwmon_temp_input:
+        case hwmon_temp_max_alarm:
+            return 0444;
+        case hwmon_temp_max:
+        case hwmon_temp_max_hyst:
+            return 0644;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Serve a temp1_* attribute from the producer state.
+ * @param dev hwmon device, its drvdata is the simtemp_dev.
+ * @param type hwmon_temp.
+ * @param attr hwmon_temp_* attribute.
+ * @param channel Always 0.
+ * @param val Returns the value, temperatures in millidegrees Celsius.
+ * @return 0 on success, -EOPNOTSUPP for attributes not exposed.
+ * @note Never touches the shared history, readers lose no samples.
+ */
+static int simtemp_hwmon_read(struct device *dev,
+    enum hwmon_sensor_types type, u32 attr, int channel, long *val) {
+    struct simtemp_dev *sdev = dev_get_drvdata(dev);
+    u32 threshold_mC, hysteresis_mC;
 
+    switch (attr) {
+        case hwmon_temp_input:
+            *val = READ_ONCE(sdev->current_temp);
+            return 0;
+        case hwmon_temp_max:
+            *val = READ_ONCE(sdev->threshold_mC);
+            return 0;
+        case hwmon_temp_max_alarm:
+            *val = READ_ONCE(sdev->alert_active);
+            return 0;
+        case hwmon_temp_max_hyst:
+            /* hwmon wants the absolute temperature the alarm clears below */
+            threshold_mC = READ_ONCE(sdev->threshold_mC);
+            hysteresis_mC = READ_ONCE(sdev->hysteresis_mC);
+            *val = threshold_mC > hysteresis_mC ?
+                threshold_mC - hysteresis_mC : 0;
+            return 0;
+        default:
+            return -EOPNOTSUPP;
+    }
+}
+
+static int simtemp_hwmon_write(struct device *dev,
+    enum hwmon_sensor_types type, u32 attr, int channel, long val) {
+    struct simtemp_dev *sdev = dev_get_drvdata(dev);
+    u32 threshold_mC, hysteresis_mC;
+
+    switch (attr) {
+        case hwmon_temp_max:
+            threshold_mC = clamp_val(val, 0, S32_MAX);
             /* START CRITICAL BLOCK */
-            spin_lock_irqsave(&sdev->lock, flags);
-            sdev->sampling_ms = cfg.sampling_ms;
-            sdev->threshold_mC = cfg.threshold_mC;
-            sdev->mode = cfg.mode;
-            hrtimer_cancel(&sdev->temp_hrtimer);
-            hrtimer_start(&sdev->temp_hrtimer, ms_to_ktime(sdev->sampling_ms),
-                HRTIMER_MODE_REL);
-            spin_unlock_irqrestore(&sdev->lock, flags);
+            spin_lock(&sdev->lock);
+            WRITE_ONCE(sdev->threshold_mC, threshold_mC);
+            spin_unlock(&sdev->lock);
             /* END CRITICAL BLOCK */
-            dev_info(sdev->dev, "Config updated via ioctl.\n");
-            break;
+            simtemp_config_changed(sdev, SIMTEMP_CFG_THRESHOLD_MC,
+                threshold_mC);
+            return 0;
+        case hwmon_temp_max_hyst:
+            /* Keep the threshold, move the point the alarm clears below */
+            /* START CRITICAL BLOCK */
+            spin_lock(&sdev->lock);
+            threshold_mC = sdev->threshold_mC;
+            hysteresis_mC = threshold_mC - min_t(u64, max(val, 0L),
+                threshold_mC);
+            WRITE_ONCE(sdev->hysteresis_mC, hysteresis_mC);
+            spin_unlock(&sdev->lock);
+            /* END CRITICAL BLOCK */
+            simtemp_config_changed(sdev, SIMTEMP_CFG_HYSTERESIS_MC,
+                hysteresis_mC);
+            return 0;
         default:
-            err = -ENOTTY;
-            break;
+            return -EOPNOTSUPP;
     }
-
-    return err;
 }
 
-static const struct file_operations simtemp_fops = {
-    .owner          = THIS_MODULE,
-    .open           = simtemp_open,
-    .release        = simtemp_release,
-    .read           = simtemp_read,
-    .poll           = simtemp_poll,
-    .unlocked_ioctl = simtemp_ioctl,
+static const struct hwmon_ops simtemp_hwmon_ops = {
+    .is_visible = simtemp_hwmon_is_visible,
+    .read = simtemp_hwmon_read,
+    .write = simtemp_hwmon_write,
+};
+
+static const struct hwmon_channel_info *simtemp_hwmon_info[] = {
+    HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT | HWMON_T_MAX |
+        HWMON_T_MAX_HYST | HWMON_T_MAX_ALARM),
+    NULL
 };
 
-static struct miscdevice misc_simtemp_dev = {
-    .minor      = TEMP_MINOR,
-    .name       = DEVICE_NODE,
-    .fops       = &simtemp_fops,
+static const struct hwmon_chip_info simtemp_hwmon_chip = {
+    .ops = &simtemp_hwmon_ops,
+    .info = simtemp_hwmon_info,
 };
 
 /**
- * @brief Get a random value as the current temperature.
+ * @brief Register the hwmon device of an instance, for lm-sensors and
+ *        scrapers that only want the current temperature.
  * @param sdev Pointer to simtemp_dev.
- * @return A random temperature value from 0 to threshold_mC,
- *         and threshold_mC + 1 every MAX_COUNT
+ * @return 0 on success, different than 0 otherwise.
  */
-static u32 get_temperature(struct simtemp_dev *sdev) {
-    u32 rand_val, temp;
-
-    /* Generate a new simulated temperature value */
-    rand_val = get_random_u32();
-    temp = rand_val % sdev->threshold_mC;
-    sdev->counter += 1;
+static int simtemp_hwmon_register(struct simtemp_dev *sdev) {
+    struct device *hwmon;
 
-    switch (sdev->mode) {
-        case MODE_RAMP:
-            /* Simulate a threshold crossed read every MAX_COUNT samples */
-            if (sdev->counter > RAMP_START) {
-                temp = sdev->threshold_mC + sdev->counter;
-                if (sdev->counter >= RAMP_STOP) {
-                    sdev->counter = 0;
-                }
-            }
-            break;
+    hwmon = hwmon_device_register_with_info(sdev->dev, sdev->name, sdev,
+        &simtemp_hwmon_chip, NULL);
+    if (IS_ERR(hwmon)) {
+        return PTR_ERR(hwmon);
     }
+    sdev->hwmon = hwmon;
 
-    return temp;
+    return 0;
 }
 
 /**
- * @brief High-resolution timer function that will be executed periodically.
- * @param timer Pointer to hrtimer struct.
- * @return A timer restart value HRTIMER_RESTART
+ * @brief Unregister the hwmon device of an instance.
+ * @param sdev Pointer to simtemp_dev.
  */
-static enum hrtimer_restart simtemp_hrtimer_callback(struct hrtimer *timer) {
-    struct simtemp_dev *sdev = container_of(timer, struct simtemp_dev,
-        temp_hrtimer);
-    struct simtemp_sample sample, drop_sample;
-    __poll_t mask = 0;
-    u16 old_flags;
-    unsigned long flags;
-    int ret;
-
-
-    /* START CRITICAL BLOCK */
-    spin_lock_irqsave(&sdev->lock, flags);
-
-    old_flags = sdev->current_flags;
-
-    /* Update global fields */
-    sdev->current_temp = get_temperature(sdev);
-    sdev->current_flags |= NEW_SAMPLE;
-    sdev->samples_taken++;
-
-    /* Get the current real time in nanoseconds since the Unix epoch */
-    sample.timestamp_ns = ktime_get_real_ns();
-    sample.temp_mC = sdev->current_temp;
-
-    if (sdev->current_temp >= sdev->threshold_mC) {
-        sdev->current_flags |= THRESHOLD_CROSSED;
-        sdev->threshold_alerts++;
-        /* Set flag to wake up pollers for urgent data (threshold crossing) */
-        mask |= POLLPRI;
-        dev_info(sdev->dev, "Threshold crossed! temp=%u mC, threshold=%u mC\n",
-                 sdev->current_temp, sdev->threshold_mC);
-
-    } else { /* Clean flags */
-        sdev->current_flags &= ~THRESHOLD_CROSSED;
-    }
-
-    sample.flags = sdev->current_flags;
-
-    /* Update FIFO */
-    if (kfifo_is_full(&sdev->kfifo)) {
-        ret = kfifo_get(&sdev->kfifo, &drop_sample);
-        dev_warn(sdev->dev, "kfifo is full, dropping latest sample: %u mC at"
-            " %llu ns, flags=0x%02x, ret=%d", drop_sample.temp_mC,
-            drop_sample.timestamp_ns, drop_sample.flags, ret);
-    }
-
-    /* Should be at least one slot for this sample*/
-    kfifo_put(&sdev->kfifo, sample);
-    /* Wake up ONE blocking reader */
-    wake_up_interruptible(&sdev->read_wait);
-    /* Wake up pollers for new data */
-    wake_up_interruptible_poll(&sdev->poll_wait, (mask | POLLIN));
+static void simtemp_hwmon_unregister(struct simtemp_dev *sdev) {
+    hwmon_device_unregister(sdev->hwmon);
+}
 
-    dev_dbg(sdev->dev, "New sample recorded: %u mC at %llu ns, flags=0x%02x\n",
-            sample.temp_mC, sample.timestamp_ns, sample.flags);
+#else
 
-    spin_unlock_irqrestore(&sdev->lock, flags);
-    /* END CRITICAL BLOCK */
+static int simtemp_hwmon_register(struct simtemp_dev *sdev) {
+    return 0;
+}
 
-    /* Restart the timer */
-    hrtimer_forward_now(timer, ms_to_ktime(sdev->sampling_ms));
-    return HRTIMER_RESTART;
+static void simtemp_hwmon_unregister(struct simtemp_dev *sdev) {
 }
 
+#endif
+
 /* --- Platform Driver Core --- */
 static int simtemp_probe(struct platform_device *pdev) {
     struct device *dev = &pdev->dev;
-    int ret;
+    struct simtemp_dev *sdev;
+    const char *gen_context, *overflow_policy, *clock;
+    u64 sampling_ns;
+    u32 period, gen_cpu, depth;
+    int ret, cpu;
 
     dev_info(dev, "Probing for simtemp device...\n");
 
-    simtemp_data = devm_kzalloc(dev, sizeof(*simtemp_data), GFP_KERNEL);
-    if (!simtemp_data) {
+    sdev = devm_kzalloc(dev, sizeof(*sdev), GFP_KERNEL);
+    if (!sdev) {
         return -ENOMEM;
     }
 
+    /* Per-CPU counters, released along with the device */
+    sdev->stats = devm_alloc_percpu(dev, struct simtemp_pcpu_stats);
+    if (!sdev->stats) {
+        return -ENOMEM;
+    }
+    for_each_possible_cpu(cpu) {
+        u64_stats_init(&per_cpu_ptr(sdev->stats, cpu)->syncp);
+    }
+
     /*
      * Link the data to the device so it gets remove automatically
      * when the devie is remove.
      */
-    platform_set_drvdata(pdev, simtemp_data);
+    platform_set_drvdata(pdev, sdev);
 
-    /* Read the 'sampling-ms' property from the device tree. */
-    ret = device_property_read_u32(dev, "sampling-ms",
-        &simtemp_data->sampling_ms);
-    if (ret) {
-        dev_err(dev, "Failed to read 'sampling-ms' property\n");
-        return ret;
+    /*
+     * Read the 'sampling-us' property from the device tree, fall back to the
+     * legacy 'sampling-ms' one.
+     */
+    ret = device_property_read_u32(dev, "sampling-us", &period);
+    if (ret == 0) {
+        sampling_ns = (u64)period * NSEC_PER_USEC;
+    } else {
+        ret = device_property_read_u32(dev, "sampling-ms", &period);
+        if (ret) {
+            dev_err(dev, "Failed to read 'sampling-us' property\n");
+            return ret;
+        }
+        sampling_ns = (u64)period * NSEC_PER_MSEC;
     }
 
     /* Read the 'threshold-mC' property from the device tree. */
-    ret = device_property_read_u32(dev, "threshold-mC",
-        &simtemp_data->threshold_mC);
+    ret = device_property_read_u32(dev, "threshold-mC", &sdev->threshold_mC);
     if (ret) {
         dev_err(dev, "Failed to read 'threshold-mC' property\n");
         return ret;
     }
 
-    dev_info(dev, "Device parameters: sampling-ms=%u, threshold-mC=%u\n",
-             simtemp_data->sampling_ms, simtemp_data->threshold_mC);
+    /* Read the optional 'hysteresis-mC' property. */
+    if (device_property_read_u32(dev, "hysteresis-mC", &sdev->hysteresis_mC)) {
+        sdev->hysteresis_mC = DEFAULT_HYSTERESIS_MC;
+    }
+
+    dev_info(dev, "Device parameters: sampling-ns=%llu, threshold-mC=%u\n",
+             sampling_ns, sdev->threshold_mC);
+
+    /* Seed the models from the optional 'seed' property or at random. */
+    if (device_property_read_u64(dev, "seed", &sdev->seed)) {
+        sdev->seed = get_random_u64();
+    }
+    simtemp_seed(sdev, sdev->seed);
 
     /* Generate a new simulated temperature value. */
-    simtemp_data->current_temp = get_temperature(simtemp_data);
-    simtemp_data->mode = MODE_NORMAL;
+    sdev->mode = MODE_NORMAL;
+    sdev->current_temp = get_temperature(sdev);
 
-    /* Initialize wait queues for read/epoll/select operations. */
-    init_waitqueue_head(&simtemp_data->read_wait);
-    init_waitqueue_head(&simtemp_data->poll_wait);
+    /*
+     * Initialize spinlock for serializing configuration updates, the sample
+     * path itself is lockless.
+     */
+    spin_lock_init(&sdev->lock);
+    spin_lock_init(&sdev->latency_lock);
+    seqcount_init(&sdev->period_seq);
+    seqcount_init(&sdev->agg_seq);
+    INIT_WORK(&sdev->nl_work, simtemp_nl_work);
+    INIT_WORK(&sdev->iio_work, simtemp_iio_work);
+    ewma_simtemp_temp_init(&sdev->ewma);
+    sdev->window_ms = DEFAULT_WINDOW_MS;
+
+    /* Read the optional 'fifo-depth' property, else use the parameter. */
+    if (device_property_read_u32(dev, "fifo-depth", &depth)) {
+        depth = fifo_depth;
+    }
+    sdev->ring_size = simtemp_ring_depth(depth);
+    if (!sdev->ring_size) {
+        dev_err(dev, "Invalid fifo depth %u (%u..%u)\n", depth,
+            MIN_RING_SIZE, MAX_RING_SIZE);
+        return -EINVAL;
+    }
 
-    /* Initialize spinlock for protecting the sample data. */
-    spin_lock_init(&simtemp_data->lock);
+    /* Header page followed by the sample slots, mappable to user space. */
+    init_rwsem(&sdev->ring_rwsem);
+    sdev->ring = simtemp_ring_alloc(sdev->ring_size);
+    if (!sdev->ring) {
+        return -ENOMEM;
+    }
+    sdev->ring_data = (void *)sdev->ring + PAGE_SIZE;
 
-    /* Allocates and initializes dynamically. */
-    INIT_KFIFO(simtemp_data->kfifo);
+    /* Records written for replay, consumed by the producer. */
+    mutex_init(&sdev->replay_lock);
+    init_waitqueue_head(&sdev->replay_wait);
+    sdev->replay_speed = 1;
+    sdev->replay_buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+    if (!sdev->replay_buf ||
+        kfifo_alloc(&sdev->replay, REPLAY_DEPTH, GFP_KERNEL)) {
+        ret = -ENOMEM;
+        goto err_free_ring;
+    }
 
     /* Initialize a high-resolution timer for simulated samples. */
-    hrtimer_init(&simtemp_data->temp_hrtimer,
-        CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    hrtimer_init(&sdev->temp_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 
     /* Set the callback function. */
-    simtemp_data->temp_hrtimer.function = &simtemp_hrtimer_callback;
+    sdev->temp_hrtimer.function = &simtemp_hrtimer_callback;
+
+    /* Read the optional 'overflow-policy' property. */
+    spin_lock_init(&sdev->readers_lock);
+    INIT_LIST_HEAD(&sdev->readers);
+    sdev->overflow_policy = OVERFLOW_DROP_OLDEST;
+    if (device_property_read_string(dev, "overflow-policy",
+            &overflow_policy) == 0) {
+        ret = match_string(overflow_policy_names,
+            ARRAY_SIZE(overflow_policy_names), overflow_policy);
+        if (ret < 0) {
+            dev_err(dev, "Invalid 'overflow-policy' property '%s'\n",
+                overflow_policy);
+            goto err_free_ring;
+        }
+        sdev->overflow_policy = ret;
+    }
+
+    /* Read the optional 'timestamp-clock' property. */
+    sdev->clock = TSCLK_REALTIME;
+    if (device_property_read_string(dev, "timestamp-clock", &clock) == 0) {
+        ret = match_string(clock_names, ARRAY_SIZE(clock_names), clock);
+        if (ret < 0) {
+            dev_err(dev, "Invalid 'timestamp-clock' property '%s'\n", clock);
+            goto err_free_ring;
+        }
+        sdev->clock = ret;
+    }
+
+    /* Read the optional 'gen-context' and 'gen-cpu' properties. */
+    mutex_init(&sdev->gen_lock);
+    sdev->gen_context = GEN_CTX_HARDIRQ;
+    sdev->gen_cpu = -1;
+    if (device_property_read_string(dev, "gen-context", &gen_context) == 0) {
+        ret = match_string(gen_context_names, ARRAY_SIZE(gen_context_names),
+            gen_context);
+        if (ret < 0) {
+            dev_err(dev, "Invalid 'gen-context' property '%s'\n",
+                gen_context);
+            goto err_free_ring;
+        }
+        sdev->gen_context = ret;
+    }
+    if (device_property_read_u32(dev, "gen-cpu", &gen_cpu) == 0) {
+        if (gen_cpu >= nr_cpu_ids || !cpu_online(gen_cpu)) {
+            dev_err(dev, "Invalid 'gen-cpu' property %u\n", gen_cpu);
+            ret = -EINVAL;
+            goto err_free_ring;
+        }
+        sdev->gen_cpu = gen_cpu;
+    }
 
     /* Save a reference to the device. */
-    simtemp_data->dev = dev;
+    sdev->dev = dev;
+
+    /* Every instance gets its own /dev/simtemp<N> node. */
+    ret = ida_alloc(&simtemp_ida, GFP_KERNEL);
+    if (ret < 0) {
+        goto err_free_ring;
+    }
+    sdev->index = ret;
+    snprintf(sdev->name, sizeof(sdev->name), DEVICE_NODE_FMT, sdev->index);
 
     /* Start the timer. */
-    hrtimer_start(&simtemp_data->temp_hrtimer,
-        ms_to_ktime(simtemp_data->sampling_ms), HRTIMER_MODE_REL);
+    ret = simtemp_set_period(sdev, sampling_ns);
+    if (ret) {
+        dev_err(dev, "Invalid sampling period %llu ns\n", sampling_ns);
+        goto err_free_index;
+    }
 
-    ret = misc_register(&misc_simtemp_dev);
+    sdev->miscdev.minor = MISC_DYNAMIC_MINOR;
+    sdev->miscdev.name = sdev->name;
+    sdev->miscdev.fops = &simtemp_fops;
+    sdev->miscdev.parent = dev;
+    ret = misc_register(&sdev->miscdev);
     if (ret) {
         dev_err(dev, "Failed to register miscdevice.\n");
-        hrtimer_cancel(&simtemp_data->temp_hrtimer);
-        return ret;
+        goto err_cancel_timer;
     }
-    simtemp_data->miscdev = &misc_simtemp_dev;
 
     ret = sysfs_create_group(&pdev->dev.kobj, &simtemp_group);
     if (ret) {
         dev_err(dev, "Failed to create sysfs attributes.\n");
-        misc_deregister(simtemp_data->miscdev);
-        hrtimer_cancel(&simtemp_data->temp_hrtimer);
-        return ret;
+        goto err_deregister;
+    }
+
+    ret = simtemp_iio_register(sdev);
+    if (ret) {
+        dev_err(dev, "Failed to register IIO device.\n");
+        goto err_remove_group;
+    }
+
+    ret = simtemp_hwmon_register(sdev);
+    if (ret) {
+        dev_err(dev, "Failed to register hwmon device.\n");
+        goto err_iio_unregister;
     }
 
+    simtemp_debugfs_init(sdev);
+
     dev_info(dev, "Found device '%s'\n", pdev->name);
-    dev_info(dev, "Device registered as /dev/%s\n", pdev->name);
-    dev_info(dev, "Read properties: sampling-ms=%u, threshold-mC=%u\n",
-        simtemp_data->sampling_ms, simtemp_data->threshold_mC);
+    dev_info(dev, "Device registered as /dev/%s\n", sdev->name);
+    dev_info(dev, "Read properties: sampling-ns=%llu, threshold-mC=%u\n",
+        sdev->sampling_ns, sdev->threshold_mC);
     dev_info(dev, "Device successfully probed!\n");
 
     return 0;
+
+err_iio_unregister:
+    simtemp_iio_unregister(sdev);
+err_remove_group:
+    sysfs_remove_group(&pdev->dev.kobj, &simtemp_group);
+err_deregister:
+    misc_deregister(&sdev->miscdev);
+err_cancel_timer:
+    mutex_lock(&sdev->gen_lock);
+    simtemp_stop_generator(sdev);
+    mutex_unlock(&sdev->gen_lock);
+    cancel_work_sync(&sdev->nl_work);
+    cancel_work_sync(&sdev->iio_work);
+err_free_index:
+    ida_free(&simtemp_ida, sdev->index);
+err_free_ring:
+    kfifo_free(&sdev->replay);
+    kfree(sdev->replay_buf);
+    vfree(sdev->ring);
+    return ret;
 }
 
 #if defined(RBPITGT)
@@ -576,14 +4124,31 @@ static void simtemp_remove(struct platform_device *pdev)
     sdev = platform_get_drvdata(pdev);
     dev_info(sdev->dev, "Removing simtemp device.\n");
 
-    /* Remove the corresponding sysfs entries. */
+    /* Stop hwmon and IIO consumers before the device goes away under them. */
+    simtemp_hwmon_unregister(sdev);
+    simtemp_iio_unregister(sdev);
+
+    /* Remove the corresponding sysfs and debugfs entries. */
     sysfs_remove_group(&pdev->dev.kobj, &simtemp_group);
+    debugfs_remove_recursive(sdev->debugfs);
 
     /* De-register the device and free its spot. */
-    misc_deregister(&misc_simtemp_dev);
+    misc_deregister(&sdev->miscdev);
+    ida_free(&simtemp_ida, sdev->index);
 
-    /* Stop the high-resolution timer before exiting. */
-    hrtimer_cancel(&sdev->temp_hrtimer);
+    /* Stop the sample generator before exiting. */
+    mutex_lock(&sdev->gen_lock);
+    simtemp_stop_generator(sdev);
+    mutex_unlock(&sdev->gen_lock);
+
+    /* The producer is stopped, so nothing queues the works again. */
+    cancel_work_sync(&sdev->nl_work);
+    cancel_work_sync(&sdev->iio_work);
+
+    /* Release the shared sample ring and the replay queue. */
+    kfifo_free(&sdev->replay);
+    kfree(sdev->replay_buf);
+    vfree(sdev->ring);
 
 #if defined(RBPITGT)
     return 0;
@@ -611,22 +4176,28 @@ static struct platform_driver simtemp_driver = {
 /*
  * Variables to hold device/driver states.
  *
- * This is needed for testing purposes so a local platform device is bind to
- * this device driver in absent of a DT's device node
+ * This is needed for testing purposes so local platform devices are bind to
+ * this device driver in absent of DT's device nodes
  */
 static bool platform_driver_registered;
-static bool platform_device_registered;
-static struct platform_device *simtemp_device_simple;
+static unsigned int platform_devices_registered;
+static struct platform_device **simtemp_devices_simple;
+
+/* Number of software devices created when no DT node is available */
+static unsigned int nr_devices = 1;
+module_param(nr_devices, uint, 0444);
+MODULE_PARM_DESC(nr_devices,
+    "Number of simulated sensors to create without a DT node (default 1)");
 
 /*
  * Define integer values as device properties as is common device tree bindings.
  */
-static const u32 prop_sampling_ms = DEFAULT_SAMPLE_MS;
+static const u32 prop_sampling_us = DEFAULT_SAMPLE_US;
 static const u32 prop_threshold_mC = DEFAULT_THRESHOLD_MC;
 
 /* Device properties */
 static struct property_entry simtemp_properties[] = {
-    PROPERTY_ENTRY_U32("sampling-ms", prop_sampling_ms),
+    PROPERTY_ENTRY_U32("sampling-us", prop_sampling_us),
     PROPERTY_ENTRY_U32("threshold-mC", prop_threshold_mC),
     { /* sentinel */ },
 };
@@ -638,6 +4209,56 @@ static struct platform_device_info simtemp_device = {
     .properties     = simtemp_properties,   // Attach our properties
 };
 
+/**
+ * @brief Unregister the software devices created by simtemp_init().
+ */
+static void simtemp_unregister_devices(void) {
+    while (platform_devices_registered > 0) {
+        platform_devices_registered--;
+        platform_device_unregister(
+            simtemp_devices_simple[platform_devices_registered]);
+    }
+    kfree(simtemp_devices_simple);
+    simtemp_devices_simple = NULL;
+}
+
+/**
+ * @brief Register nr_devices software devices.
+ * @return 0 if every device was registered, different than 0 otherwise.
+ */
+static int simtemp_register_devices(void) {
+    struct platform_device *pdev;
+    unsigned int i;
+
+    if (nr_devices == 0 || nr_devices > MAX_DEVICES) {
+        pr_err(DRIVER_NAME": nr_devices must be between 1 and %u\n",
+            MAX_DEVICES);
+        return -EINVAL;
+    }
+
+    simtemp_devices_simple = kcalloc(nr_devices, sizeof(pdev), GFP_KERNEL);
+    if (!simtemp_devices_simple) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < nr_devices; i++) {
+        /* A single device keeps the legacy /sys/devices/platform/simtemp */
+        simtemp_device.id = (nr_devices == 1) ? PLATFORM_DEVID_NONE : i;
+        pdev = platform_device_register_full(&simtemp_device);
+        if (IS_ERR(pdev)) {
+            pr_err(DRIVER_NAME": Failed to add platform device %u with"
+                " properties: %ld\n", i, PTR_ERR(pdev));
+            simtemp_unregister_devices();
+            return PTR_ERR(pdev);
+        }
+        simtemp_devices_simple[platform_devices_registered++] = pdev;
+    }
+
+    pr_info(DRIVER_NAME": %u platform device(s) %s were registered"
+        " correctly\n", platform_devices_registered, simtemp_device.name);
+    return 0;
+}
+
 /**
  * @brief Entry point for device driver call at insmod.
  * @return 0 if device allocation and proving successed,
@@ -648,7 +4269,16 @@ static int __init simtemp_init(void) {
 
     pr_info(DRIVER_NAME": Entry point\n");
 
-    /* Try to bind the device registered in the device tree blob (DTB) */
+    /* Instances publish to the netlink family as soon as they probe */
+    retval = genl_register_family(&simtemp_nl_family);
+    if (retval) {
+        pr_err(DRIVER_NAME": Failed to register netlink family: %d\n", retval);
+        return retval;
+    }
+
+    simtemp_debugfs_root = debugfs_create_dir(DRIVER_NAME, NULL);
+
+    /* Try to bind the devices registered in the device tree blob (DTB) */
     retval = platform_driver_probe(&simtemp_driver, simtemp_probe);
     if (retval == 0) {
         platform_driver_registered = true;
@@ -661,23 +4291,14 @@ static int __init simtemp_init(void) {
 
     /*
      * If prove failed, then the DTB entry is not available
-     * so create a software device for testing purposes
+     * so create software devices for testing purposes
      */
     if (platform_driver_registered == false) {
-        simtemp_device_simple = platform_device_register_full(&simtemp_device);
-        if (IS_ERR(simtemp_device_simple)) {
-            retval = PTR_ERR(simtemp_device_simple);
-            pr_err(DRIVER_NAME": Failed to add platform device with properties:"
-                "%d\n", retval);
-        } else {
-            platform_device_registered = true;
-            pr_info(DRIVER_NAME": Platform device %s was registered"
-                " correctly\n", simtemp_device.name);
-        }
+        retval = simtemp_register_devices();
     }
 
-    /* If the software device was created, then try to bind again. */
-    if (platform_device_registered == true) {
+    /* If the software devices were created, then try to bind again. */
+    if (platform_devices_registered > 0) {
         retval = platform_driver_probe(&simtemp_driver, simtemp_probe);
         if (retval == 0) {
             platform_driver_registered = true;
@@ -691,12 +4312,12 @@ static int __init simtemp_init(void) {
 
     /* If any errors, release memory/structs allocated. */
     if (retval) {
-        if (platform_device_registered) {
-            platform_device_unregister(simtemp_device_simple);
-        }
+        simtemp_unregister_devices();
         if (platform_driver_registered) {
             platform_driver_unregister(&simtemp_driver);
         }
+        debugfs_remove_recursive(simtemp_debugfs_root);
+        genl_unregister_family(&simtemp_nl_family);
     }
 
     return retval;
@@ -708,12 +4329,14 @@ static int __init simtemp_init(void) {
 static void __exit simtemp_exit(void) {
     pr_info(DRIVER_NAME": Exit point\n");
 
-    if (platform_device_registered) {
-        platform_device_unregister(simtemp_device_simple);
-    }
+    simtemp_unregister_devices();
     if (platform_driver_registered) {
         platform_driver_unregister(&simtemp_driver);
     }
+    /* The last release() drops the module, its file may still be queued */
+    rcu_barrier();
+    debugfs_remove_recursive(simtemp_debugfs_root);
+    genl_unregister_family(&simtemp_nl_family);
 }
 
 /* Register entry/exit points. */
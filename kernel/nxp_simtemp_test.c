@@ -9,18 +9,28 @@
  * See README.md for more information.
  */
 
+#define _GNU_SOURCE  // For splice()
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
 #include <time.h>
 #include <sys/ioctl.h>
 #include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
 
 /* NXP defined structs */
 #include "include/nxp_simtemp.h"
 #include "include/nxp_simtemp_ioctl.h"
+#include "include/nxp_simtemp_netlink.h"
 #include "include/nxp_simtemp_test.h"
 
 /**
@@ -49,15 +59,700 @@ void print_help(char *prog_name) {
     fprintf(stderr, "Usage: %s [options]\n", prog_name);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -s <ms>           Set sampling period via sysfs.\n");
+    fprintf(stderr, "  -u <us>           Set sampling period in microseconds via"
+                                         " sysfs.\n");
     fprintf(stderr, "  -t <mC>           Set threshold via sysfs.\n");
-    fprintf(stderr, "  -m <mode>         Set mode via sysfs (normal|ramp).\n");
+    fprintf(stderr, "  -m <mode>         Set mode via sysfs (normal|ramp|sine|"
+                                         "sawtooth|step|noise|replay).\n");
     fprintf(stderr, "  -i <ms>:<mC>:<mode>  Set all via ioctl (mode: 0=normal,"
-                                         " 1=ramp).\n");
+                                         " 1=ramp, 2=sine, 3=sawtooth, 4=step,"
+                                         " 5=noise, 6=replay).\n");
     fprintf(stderr, "  -p                Run in poll loop, printing samples and"
                                          " alerts.\n");
+    fprintf(stderr, "  -r                Run in poll loop, consuming samples from"
+                                         " the mmap() ring.\n");
+    fprintf(stderr, "  -f <fmt>          Run in poll loop, reading compact|raw"
+                                         " records.\n");
+    fprintf(stderr, "  -C <n> <file>     Capture <n> samples into <file>.\n");
+    fprintf(stderr, "  -w <file>         Replay the samples captured in <file>"
+                                         " (needs mode replay).\n");
+    fprintf(stderr, "  -l <n>            Read <n> samples and print their"
+                                         " delivery latency.\n");
+    fprintf(stderr, "  -W <n> <us>       Block in read() until <n> samples are"
+                                         " queued or the oldest waited <us>.\n");
+    fprintf(stderr, "  -U <n>            Read <n> samples through io_uring.\n");
+    fprintf(stderr, "  -S <n> <file>     Splice <n> samples into <file>.\n");
+    fprintf(stderr, "  -n <group>        Print what netlink multicasts to the"
+                                         " samples|alerts group.\n");
+    fprintf(stderr, "  -g                Print configuration, counters and"
+                                         " newest sample via ioctl.\n");
+    fprintf(stderr, "  -F <f>=<v>[,...]  Set config fields in one ioctl (e.g."
+                                         " threshold_mC=40000,mode=2).\n");
+    fprintf(stderr, "  -a                Print the rolling statistics of the"
+                                         " last window.\n");
+    fprintf(stderr, "  -k [clock]        Select (realtime|monotonic|"
+                                         "monotonic-raw|boottime|tai, -fast"
+                                         " suffix for NMI-safe) and print the"
+                                         " timestamp clock.\n");
     exit(EXIT_FAILURE);
 }
 
+/**
+ * @brief Print a sample.
+ * @param sample Sample to print.
+ */
+void print_sample(const struct simtemp_sample *sample) {
+    char timestamp_str[64];
+
+    ns_to_iso8601(sample->timestamp_ns, timestamp_str, sizeof(timestamp_str));
+    if (sample->flags & DATA_GAP) {
+        printf("%s gap (samples lost before this one)\n", timestamp_str);
+    }
+    if (sample->flags & THRESHOLD_CROSSED) {
+        printf("%s temp=%.3fC alert=1 (Threshold crossed)\n",
+            timestamp_str, (float)sample->temp_mC / 1000.0);
+    } else {
+        printf("%s temp=%.3fC alert=0\n",
+            timestamp_str, (float)sample->temp_mC / 1000.0);
+    }
+}
+
+/**
+ * @brief Print an alert returned by SIMTEMP_IOC_GET_ALERT.
+ * @param alert Alert to print.
+ */
+void print_alert(const struct simtemp_alert *alert) {
+    char timestamp_str[64];
+
+    ns_to_iso8601(alert->timestamp_ns, timestamp_str, sizeof(timestamp_str));
+    if (alert->lost) {
+        printf("%s %u alerts lost\n", timestamp_str, alert->lost);
+    }
+    printf("%s alert %s temp=%.3fC threshold=%.3fC\n", timestamp_str,
+        alert->type == SIMTEMP_ALERT_RISING ? "rising" : "falling",
+        (float)alert->temp_mC / 1000.0, (float)alert->threshold_mC / 1000.0);
+}
+
+/**
+ * @brief Decode and print the records returned by read().
+ * @param buf Records.
+ * @param len Number of bytes in buf.
+ * @param format SIMTEMP_FMT_COMPACT or SIMTEMP_FMT_RAW.
+ * @param sync_ns Timestamp of the last sync record, updated.
+ */
+void print_records(const char *buf, size_t len, __u32 format,
+    __u64 *sync_ns) {
+    struct simtemp_sample sample;
+    struct simtemp_sample_compact rec;
+    __u32 raw;
+    size_t off = 0;
+
+    while (off < len) {
+        if (format == SIMTEMP_FMT_RAW) {
+            memcpy(&raw, buf + off, sizeof(raw));
+            off += sizeof(raw);
+            printf("temp=%.3fC flags=0x%x\n",
+                (float)(raw & SIMTEMP_TEMP_MASK) / 1000.0,
+                raw >> SIMTEMP_FLAGS_SHIFT);
+            continue;
+        }
+
+        memcpy(&rec, buf + off, sizeof(rec));
+        off += sizeof(rec);
+        if ((rec.temp_flags >> SIMTEMP_FLAGS_SHIFT) & SIMTEMP_SYNC) {
+            memcpy(sync_ns, buf + off, sizeof(*sync_ns));
+            off += sizeof(*sync_ns);
+        }
+        sample.timestamp_ns = *sync_ns + (__u64)rec.delta_us * 1000;
+        sample.temp_mC = rec.temp_flags & SIMTEMP_TEMP_MASK;
+        sample.flags = (rec.temp_flags >> SIMTEMP_FLAGS_SHIFT) & ~SIMTEMP_SYNC;
+        print_sample(&sample);
+    }
+}
+
+/**
+ * @brief Print the delivery latency reported by SIMTEMP_IOC_GET_LATENCY.
+ * @param lat Latency summary to print.
+ */
+void print_latency(const struct simtemp_latency *lat) {
+    int i;
+
+    printf("samples=%llu mean=%lluns max=%lluns\n",
+        (unsigned long long)lat->count, (unsigned long long)lat->mean_ns,
+        (unsigned long long)lat->max_ns);
+    printf("p50<=%lluns p90<=%lluns p99<=%lluns p99.9<=%lluns\n",
+        (unsigned long long)lat->p50_ns, (unsigned long long)lat->p90_ns,
+        (unsigned long long)lat->p99_ns, (unsigned long long)lat->p999_ns);
+    for (i = 0; i < SIMTEMP_LATENCY_BUCKETS; i++) {
+        if (lat->buckets[i] > 0) {
+            printf("  < 2^%-2d ns: %llu\n", i,
+                (unsigned long long)lat->buckets[i]);
+        }
+    }
+}
+
+/**
+ * @brief Print one window reported by SIMTEMP_IOC_GET_AGGREGATE.
+ * @param name Label of the window.
+ * @param win Window summary to print.
+ */
+void print_window(const char *name, const struct simtemp_window_stats *win) {
+    printf("%s: samples=%u min=%.3fC max=%.3fC mean=%.3fC var=%llumC^2"
+        " ewma=%.3fC above=%u\n", name, win->count,
+        (float)win->min_mC / 1000.0, (float)win->max_mC / 1000.0,
+        (float)win->mean_mC / 1000.0, (unsigned long long)win->variance_mC2,
+        (float)win->ewma_mC / 1000.0, win->above);
+}
+
+/**
+ * @brief Consume samples from the mmap() ring until interrupted.
+ * @param fd Opened device file descriptor.
+ * @return 0 on success, 1 otherwise.
+ */
+int run_ring_loop(int fd) {
+    const struct simtemp_ring_header *hdr;
+    const struct simtemp_sample *slots;
+    struct simtemp_ring_ctrl *ctrl;
+    struct simtemp_sample sample;
+    struct pollfd pfd;
+    __u64 head, tail, seq, rewrite_seq;
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t ring_len;
+
+    hdr = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd,
+        SIMTEMP_MMAP_RING_OFFSET);
+    if (hdr == MAP_FAILED) {
+        perror("mmap ring");
+        return 1;
+    }
+    ring_len = hdr->data_offset + (size_t)hdr->size * hdr->sample_size;
+    munmap((void *)hdr, page_size);
+
+    hdr = mmap(NULL, ring_len, PROT_READ, MAP_SHARED, fd,
+        SIMTEMP_MMAP_RING_OFFSET);
+    if (hdr == MAP_FAILED) {
+        perror("mmap ring");
+        return 1;
+    }
+    slots = (const void *)((const char *)hdr + hdr->data_offset);
+
+    ctrl = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+        SIMTEMP_MMAP_CTRL_OFFSET);
+    if (ctrl == MAP_FAILED) {
+        perror("mmap ctrl");
+        munmap((void *)hdr, ring_len);
+        return 1;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    tail = ctrl->tail;
+
+    printf("Consuming samples from the mmap() ring. Ctrl+C to exit.\n");
+
+    while (1) {
+        if (poll(&pfd, 1, -1) < 0) {
+            perror("poll");
+            break;
+        }
+
+        head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+        if (head - tail > hdr->size - 1) {
+            printf("Overrun, lost %llu samples\n",
+                (unsigned long long)(head - (hdr->size - 1) - tail));
+            tail = head - (hdr->size - 1);
+        }
+
+        for (seq = tail; seq != head; seq++) {
+            /* The newest slot may be rewritten in place, copy it again */
+            do {
+                rewrite_seq = __atomic_load_n(&hdr->rewrite_seq,
+                    __ATOMIC_ACQUIRE);
+                sample = slots[seq & (hdr->size - 1)];
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            } while ((rewrite_seq & 1) ||
+                __atomic_load_n(&hdr->rewrite_seq, __ATOMIC_RELAXED) !=
+                rewrite_seq);
+            /* Discard the slot if the producer lapped it while copying */
+            if (__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) - seq >=
+                hdr->size) {
+                continue;
+            }
+            print_sample(&sample);
+        }
+        tail = head;
+        __atomic_store_n(&ctrl->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    munmap(ctrl, page_size);
+    munmap((void *)hdr, ring_len);
+    return 0;
+}
+
+/**
+ * @brief Read samples through io_uring, without liburing.
+ * @param fd Opened device file descriptor.
+ * @param count Number of samples to read.
+ * @return 0 on success, 1 otherwise.
+ * @note One IORING_OP_READV in flight at a time, which every io_uring
+ *       capable kernel supports.
+ */
+int run_uring_reader(int fd, long count) {
+    struct simtemp_sample samples[SAMPLES_PER_READ];
+    struct iovec iov = { samples, sizeof(samples) };
+    struct io_uring_params params;
+    struct io_uring_sqe *sqes, *sqe;
+    struct io_uring_cqe *cqes;
+    unsigned int *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+    unsigned int tail, head, idx;
+    size_t sq_len, cq_len, sqes_len;
+    void *sq_ptr, *cq_ptr;
+    int ring_fd, res, i, ret = 1;
+
+    memset(&params, 0, sizeof(params));
+    ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring_fd < 0) {
+        perror("io_uring_setup");
+        return 1;
+    }
+
+    sq_len = params.sq_off.array + params.sq_entries * sizeof(__u32);
+    cq_len = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+    sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    sq_ptr = mmap(NULL, sq_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    cq_ptr = mmap(NULL, cq_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    sqes = mmap(NULL, sqes_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+        perror("mmap io_uring");
+        goto out;
+    }
+    sq_tail = (unsigned int *)((char *)sq_ptr + params.sq_off.tail);
+    sq_mask = (unsigned int *)((char *)sq_ptr + params.sq_off.ring_mask);
+    sq_array = (unsigned int *)((char *)sq_ptr + params.sq_off.array);
+    cq_head = (unsigned int *)((char *)cq_ptr + params.cq_off.head);
+    cq_tail = (unsigned int *)((char *)cq_ptr + params.cq_off.tail);
+    cq_mask = (unsigned int *)((char *)cq_ptr + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)((char *)cq_ptr + params.cq_off.cqes);
+
+    while (count > 0) {
+        /* Queue one read of up to SAMPLES_PER_READ samples */
+        tail = *sq_tail;
+        idx = tail & *sq_mask;
+        sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long)&iov;
+        sqe->len = 1;
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        if (syscall(__NR_io_uring_enter, ring_fd, 1, 1,
+                IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+            perror("io_uring_enter");
+            goto out;
+        }
+
+        head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        res = cqes[head & *cq_mask].res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        if (res < 0) {
+            fprintf(stderr, "io_uring read: %s\n", strerror(-res));
+            goto out;
+        }
+
+        for (i = 0; i < res / (int)sizeof(samples[0]); i++) {
+            print_sample(&samples[i]);
+        }
+        count -= res / (int)sizeof(samples[0]);
+    }
+    ret = 0;
+
+out:
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqes_len);
+    }
+    if (cq_ptr != MAP_FAILED) {
+        munmap(cq_ptr, cq_len);
+    }
+    if (sq_ptr != MAP_FAILED) {
+        munmap(sq_ptr, sq_len);
+    }
+    close(ring_fd);
+    return ret;
+}
+
+/**
+ * @brief Move samples into a file through a pipe with splice().
+ * @param fd Opened device file descriptor.
+ * @param count Number of samples to move.
+ * @param path Destination file.
+ * @return 0 on success, 1 otherwise.
+ * @note The samples never pass through a user space buffer.
+ */
+int run_splice(int fd, long count, const char *path) {
+    size_t remaining = count * sizeof(struct simtemp_sample);
+    ssize_t moved, out_len;
+    int pipefd[2], out, ret = 1;
+
+    out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        perror("open capture");
+        return 1;
+    }
+    if (pipe(pipefd) < 0) {
+        perror("pipe");
+        close(out);
+        return 1;
+    }
+
+    while (remaining > 0) {
+        moved = splice(fd, NULL, pipefd[1], NULL, remaining, SPLICE_F_MOVE);
+        if (moved <= 0) {
+            perror("splice device");
+            goto out;
+        }
+        remaining -= moved;
+        while (moved > 0) {
+            out_len = splice(pipefd[0], NULL, out, NULL, moved, SPLICE_F_MOVE);
+            if (out_len <= 0) {
+                perror("splice file");
+                goto out;
+            }
+            moved -= out_len;
+        }
+    }
+    printf("Spliced %ld samples into %s.\n", count, path);
+    ret = 0;
+
+out:
+    close(pipefd[0]);
+    close(pipefd[1]);
+    close(out);
+    return ret;
+}
+
+/**
+ * @brief Resolve the simtemp family and one of its multicast groups.
+ * @param sock Generic netlink socket.
+ * @param group Multicast group name.
+ * @param family_id Returns the family id.
+ * @return Group id, -1 on failure.
+ */
+int nl_resolve_group(int sock, const char *group, __u16 *family_id) {
+    struct {
+        struct nlmsghdr nlh;
+        struct genlmsghdr genl;
+        char attrs[256];
+    } req;
+    char buf[NL_BUF_SIZE];
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+    struct nlattr *nla, *grp, *field;
+    int len, rem, grp_rem, field_rem, grp_id;
+    const char *name;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_type = GENL_ID_CTRL;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST;
+    req.genl.cmd = CTRL_CMD_GETFAMILY;
+    req.genl.version = 1;
+    nla = (struct nlattr *)req.attrs;
+    nla->nla_type = CTRL_ATTR_FAMILY_NAME;
+    nla->nla_len = NLA_HDRLEN + sizeof(SIMTEMP_NL_FAMILY_NAME);
+    memcpy(NL_ATTR_DATA(nla), SIMTEMP_NL_FAMILY_NAME,
+        sizeof(SIMTEMP_NL_FAMILY_NAME));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN) + NLA_ALIGN(nla->nla_len);
+
+    if (send(sock, &req, req.nlh.nlmsg_len, 0) < 0) {
+        perror("send");
+        return -1;
+    }
+    len = recv(sock, buf, sizeof(buf), 0);
+    if (len < 0 || !NLMSG_OK(nlh, len) || nlh->nlmsg_type == NLMSG_ERROR) {
+        fprintf(stderr, "Netlink family %s not found, is the module loaded?\n",
+            SIMTEMP_NL_FAMILY_NAME);
+        return -1;
+    }
+
+    /* Walk the reply for the family id and the group list */
+    grp_id = -1;
+    nl_for_each_attr(nla, NL_GENL_ATTRS(nlh), NL_GENL_ATTRLEN(nlh), rem) {
+        if (nla->nla_type == CTRL_ATTR_FAMILY_ID) {
+            *family_id = *(__u16 *)NL_ATTR_DATA(nla);
+        }
+        if ((nla->nla_type & NLA_TYPE_MASK) != CTRL_ATTR_MCAST_GROUPS) {
+            continue;
+        }
+        nl_for_each_attr(grp, NL_ATTR_DATA(nla), NL_ATTR_LEN(nla), grp_rem) {
+            name = NULL;
+            nl_for_each_attr(field, NL_ATTR_DATA(grp), NL_ATTR_LEN(grp),
+                field_rem) {
+                if (field->nla_type == CTRL_ATTR_MCAST_GRP_NAME) {
+                    name = NL_ATTR_DATA(field);
+                } else if (field->nla_type == CTRL_ATTR_MCAST_GRP_ID &&
+                    name && strcmp(name, group) == 0) {
+                    grp_id = *(__u32 *)NL_ATTR_DATA(field);
+                }
+            }
+        }
+    }
+
+    return grp_id;
+}
+
+/**
+ * @brief Subscribe to a simtemp multicast group and print what arrives.
+ * @param group SIMTEMP_NL_GRP_SAMPLES_NAME or SIMTEMP_NL_GRP_ALERTS_NAME.
+ * @return 1 on failure, runs until interrupted otherwise.
+ */
+int run_netlink_listener(const char *group) {
+    struct sockaddr_nl addr;
+    struct nlmsghdr *nlh;
+    struct nlattr *nla;
+    struct simtemp_alert alert;
+    const struct simtemp_sample *samples;
+    char buf[NL_BUF_SIZE];
+    __u64 lost;
+    __u32 device = 0;
+    __u16 family_id = 0;
+    int sock, grp_id, len, rem, i;
+
+    sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(sock);
+        return 1;
+    }
+
+    grp_id = nl_resolve_group(sock, group, &family_id);
+    if (grp_id < 0) {
+        close(sock);
+        return 1;
+    }
+    if (setsockopt(sock, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &grp_id,
+            sizeof(grp_id)) < 0) {
+        perror("setsockopt");
+        close(sock);
+        return 1;
+    }
+
+    printf("Subscribed to %s/%s. Ctrl+C to exit.\n", SIMTEMP_NL_FAMILY_NAME,
+        group);
+    while ((len = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (__u32)len);
+            nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type != family_id) {
+                continue;
+            }
+            nl_for_each_attr(nla, NL_GENL_ATTRS(nlh), NL_GENL_ATTRLEN(nlh),
+                rem) {
+                switch (nla->nla_type) {
+                    case SIMTEMP_NL_ATTR_DEVICE:
+                        memcpy(&device, NL_ATTR_DATA(nla), sizeof(device));
+                        break;
+                    case SIMTEMP_NL_ATTR_LOST:
+                        memcpy(&lost, NL_ATTR_DATA(nla), sizeof(lost));
+                        if (lost) {
+                            printf("simtemp%u: %llu samples lost\n", device,
+                                (unsigned long long)lost);
+                        }
+                        break;
+                    case SIMTEMP_NL_ATTR_SAMPLES:
+                        samples = NL_ATTR_DATA(nla);
+                        for (i = 0; i < (int)(NL_ATTR_LEN(nla) /
+                            sizeof(*samples)); i++) {
+                            printf("simtemp%u: ", device);
+                            print_sample(&samples[i]);
+                        }
+                        break;
+                    case SIMTEMP_NL_ATTR_ALERT:
+                        memcpy(&alert, NL_ATTR_DATA(nla), sizeof(alert));
+                        printf("simtemp%u: ", device);
+                        print_alert(&alert);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    perror("recv");
+    close(sock);
+    return 1;
+}
+
+/* Fields -F understands, in struct simtemp_dev_config */
+#define CONFIG_FIELD(field, flag) \
+    { #field, flag, offsetof(struct simtemp_dev_config, field), \
+      sizeof(((struct simtemp_dev_config *)0)->field) }
+static const struct {
+    const char *name;
+    __u32 flag;
+    size_t offset;
+    size_t size;
+} config_fields[] = {
+    CONFIG_FIELD(sampling_ns, SIMTEMP_CFG_F_SAMPLING_NS),
+    CONFIG_FIELD(threshold_mC, SIMTEMP_CFG_F_THRESHOLD_MC),
+    CONFIG_FIELD(hysteresis_mC, SIMTEMP_CFG_F_HYSTERESIS_MC),
+    CONFIG_FIELD(mode, SIMTEMP_CFG_F_MODE),
+    CONFIG_FIELD(overflow_policy, SIMTEMP_CFG_F_OVERFLOW_POLICY),
+    CONFIG_FIELD(fifo_depth, SIMTEMP_CFG_F_FIFO_DEPTH),
+    CONFIG_FIELD(gen_context, SIMTEMP_CFG_F_GEN_CONTEXT),
+    CONFIG_FIELD(gen_cpu, SIMTEMP_CFG_F_GEN_CONTEXT),
+    CONFIG_FIELD(window_ms, SIMTEMP_CFG_F_WINDOW_MS),
+    CONFIG_FIELD(replay_speed, SIMTEMP_CFG_F_REPLAY_SPEED),
+    CONFIG_FIELD(seed, SIMTEMP_CFG_F_SEED),
+};
+
+/**
+ * @brief Store one field=value pair into a configuration.
+ * @param cfg Configuration to update, its mask gets the field flag.
+ * @param pair "field=value", values are numeric.
+ * @return 0 on success, -1 for an unknown field.
+ */
+int set_config_field(struct simtemp_dev_config *cfg, char *pair) {
+    char *value = strchr(pair, '=');
+    __u64 val64;
+    __u32 val32;
+    size_t i;
+
+    if (!value) {
+        return -1;
+    }
+    *value++ = '\0';
+    /* Negative values (gen_cpu=-1) wrap to their two's complement */
+    val64 = strtoull(value, NULL, 0);
+    val32 = (__u32)val64;
+
+    for (i = 0; i < sizeof(config_fields) / sizeof(config_fields[0]); i++) {
+        if (strcmp(pair, config_fields[i].name) == 0) {
+            memcpy((char *)cfg + config_fields[i].offset,
+                config_fields[i].size == sizeof(val64) ?
+                (void *)&val64 : (void *)&val32, config_fields[i].size);
+            cfg->mask |= config_fields[i].flag;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Print configuration, counters and newest sample of a device.
+ * @param cfg Configuration returned by SIMTEMP_IOC_GET_CONFIG.
+ * @param stats Counters returned by SIMTEMP_IOC_GET_STATS.
+ * @param counters Counters returned by SIMTEMP_IOC_GET_COUNTERS.
+ * @param latest Newest sample from SIMTEMP_IOC_GET_LATEST, NULL if none.
+ */
+void print_device(const struct simtemp_dev_config *cfg,
+    const struct simtemp_dev_stats *stats,
+    const struct simtemp_counters *counters,
+    const struct simtemp_latest *latest) {
+    printf("sampling_ns=%llu threshold_mC=%u hysteresis_mC=%u mode=%u\n",
+        (unsigned long long)cfg->sampling_ns, cfg->threshold_mC,
+        cfg->hysteresis_mC, cfg->mode);
+    printf("overflow_policy=%u fifo_depth=%u gen_context=%u gen_cpu=%d\n",
+        cfg->overflow_policy, cfg->fifo_depth, cfg->gen_context,
+        cfg->gen_cpu);
+    printf("window_ms=%u replay_speed=%u seed=%llu\n", cfg->window_ms,
+        cfg->replay_speed, (unsigned long long)cfg->seed);
+    printf("samples_taken=%llu threshold_alerts=%llu missed_periods=%llu\n",
+        (unsigned long long)stats->samples_taken,
+        (unsigned long long)stats->threshold_alerts,
+        (unsigned long long)stats->missed_periods);
+    printf("dropped_oldest=%llu dropped_newest=%llu overwritten=%llu"
+        " replayed=%llu\n", (unsigned long long)stats->dropped_oldest,
+        (unsigned long long)stats->dropped_newest,
+        (unsigned long long)stats->overwritten,
+        (unsigned long long)stats->replayed);
+    printf("samples_dropped=%llu reads=%llu bytes_read=%llu empty_reads=%llu\n",
+        (unsigned long long)counters->samples_dropped,
+        (unsigned long long)counters->reads,
+        (unsigned long long)counters->bytes_read,
+        (unsigned long long)counters->empty_reads);
+    printf("wakeups=%llu polls=%llu timer_overruns=%llu config_changes=%llu\n",
+        (unsigned long long)counters->wakeups,
+        (unsigned long long)counters->polls,
+        (unsigned long long)counters->timer_overruns,
+        (unsigned long long)counters->config_changes);
+    if (latest) {
+        printf("latest #%llu: ", (unsigned long long)latest->seq);
+        print_sample(&latest->sample);
+    }
+}
+
+/* Timestamp clock names, indexed by TSCLK_* */
+static const char * const clock_names[] = {
+    "realtime", "monotonic", "monotonic-raw", "boottime", "tai",
+    "realtime-fast", "monotonic-fast", "monotonic-raw-fast", "boottime-fast",
+    "tai-fast",
+};
+
+/**
+ * @brief Optionally select the timestamp clock, then print it with the age
+ *        of the newest sample measured on the same clock.
+ * @param fd Device file descriptor.
+ * @param clock Clock name to select, NULL to keep the current one.
+ * @return 0 on success, 1 otherwise.
+ */
+int run_clock(int fd, const char *clock) {
+    struct simtemp_clock clk;
+    struct simtemp_latest latest;
+    struct timespec now;
+    size_t i;
+
+    memset(&clk, 0, sizeof(clk));
+    if (clock) {
+        for (i = 0; i < sizeof(clock_names) / sizeof(clock_names[0]); i++) {
+            if (strcmp(clock, clock_names[i]) == 0) {
+                break;
+            }
+        }
+        if (i == sizeof(clock_names) / sizeof(clock_names[0])) {
+            fprintf(stderr, "Unknown clock: %s\n", clock);
+            return 1;
+        }
+        clk.clock = i;
+        if (ioctl(fd, SIMTEMP_IOC_SET_CLOCK, &clk) < 0) {
+            perror("ioctl");
+            return 1;
+        }
+    }
+
+    if (ioctl(fd, SIMTEMP_IOC_GET_CLOCK, &clk) < 0) {
+        perror("ioctl");
+        return 1;
+    }
+    printf("clock=%s clockid=%d fast=%u\n",
+        clk.clock < sizeof(clock_names) / sizeof(clock_names[0]) ?
+        clock_names[clk.clock] : "unknown", clk.clockid, clk.fast);
+
+    /* Samples stamped before a clock change are on the previous clock */
+    if (ioctl(fd, SIMTEMP_IOC_GET_LATEST, &latest) == 0 &&
+        clock_gettime(clk.clockid, &now) == 0) {
+        printf("newest sample #%llu is %lld ns old\n",
+            (unsigned long long)latest.seq,
+            (long long)((__u64)now.tv_sec * 1000000000ULL + now.tv_nsec -
+            latest.sample.timestamp_ns));
+    }
+
+    return 0;
+}
+
 /**
  * @brief Entry point
  * @param argc Parameters counter.
@@ -68,10 +763,23 @@ int main(int argc, char *argv[]) {
     char path[256];
     struct pollfd pfd;
     int ret;
-    char timestamp_str[64];
-    struct simtemp_sample sample;
+    struct simtemp_sample samples[SAMPLES_PER_READ];
+    ssize_t nread;
+    int i;
     struct simtemp_config cfg;
+    struct simtemp_latency lat;
+    struct simtemp_aggregate agg;
+    struct simtemp_alert alert;
+    struct simtemp_wakeup wakeup;
+    struct simtemp_dev_config dev_cfg;
+    struct simtemp_dev_stats stats;
+    struct simtemp_counters counters;
+    struct simtemp_latest latest;
     char *token, *saveptr1;
+    long remaining;
+    int in, out;
+    __u32 format;
+    __u64 sync_ns = 0;
 
     if (argc < 2) {
         print_help(argv[0]);
@@ -91,6 +799,20 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
+    if (strcmp(argv[1], "-u") == 0 && argc == 3) {
+        snprintf(path, sizeof(path), DEVICE_PATH"/sampling_us");
+        fd = open(path, O_WRONLY);
+        if (fd < 0) {
+            perror("open sysfs"); return 1;
+        }
+        if (write(fd, argv[2], strlen(argv[2])) < 0) {
+            perror("write sysfs"); return 1;
+        }
+        close(fd);
+        printf("Set sampling_us to %s via sysfs.\n", argv[2]);
+        return 0;
+    }
+
     if (strcmp(argv[1], "-t") == 0 && argc == 3) {
         snprintf(path, sizeof(path), DEVICE_PATH"/threshold_mC");
         fd = open(path, O_WRONLY);
@@ -185,23 +907,294 @@ int main(int argc, char *argv[]) {
                 break;
             }
 
-            if ((pfd.revents & (POLLIN | POLLPRI)) > 0) {
-                if (read(fd, &sample, sizeof(sample)) == sizeof(sample)) {
-                    ns_to_iso8601(sample.timestamp_ns, timestamp_str,
-                        sizeof(timestamp_str));
-                    if (pfd.revents & POLLPRI) {
-                        printf("%s live alert\n", timestamp_str);
-                    }
-                    if (sample.flags & THRESHOLD_CROSSED) {
-                        printf("%s temp=%.3fC alert=1 (Threshold crossed)\n",
-                            timestamp_str, (float)sample.temp_mC / 1000.0);
-                    } else {
-                        printf("%s temp=%.3fC alert=0\n",
-                            timestamp_str, (float)sample.temp_mC / 1000.0);
-                    }
+            if (pfd.revents & POLLPRI) {
+                /* Alerts are queued apart from the samples, drain them */
+                while (ioctl(fd, SIMTEMP_IOC_GET_ALERT, &alert) == 0) {
+                    print_alert(&alert);
+                }
+            }
+            if (pfd.revents & POLLIN) {
+                /* Drain every queued sample in a single read() */
+                nread = read(fd, samples, sizeof(samples));
+                if (nread < (ssize_t)sizeof(samples[0])) {
+                    continue;
                 }
+                for (i = 0; i < nread / (ssize_t)sizeof(samples[0]); i++) {
+                    print_sample(&samples[i]);
+                }
+            }
+        }
+        close(fd);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "-r") == 0) {
+        /* The control page is mapped writable, which needs a writable fd */
+        fd = open(DEVICE_FILE, O_RDWR);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        ret = run_ring_loop(fd);
+        close(fd);
+        return ret;
+    }
+
+    if (strcmp(argv[1], "-f") == 0 && argc == 3) {
+        if (strcmp(argv[2], "compact") == 0) {
+            format = SIMTEMP_FMT_COMPACT;
+        } else if (strcmp(argv[2], "raw") == 0) {
+            format = SIMTEMP_FMT_RAW;
+        } else {
+            print_help(argv[0]);
+        }
+
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        if (ioctl(fd, SIMTEMP_IOC_SET_FORMAT, &format) < 0) {
+            perror("ioctl");
+            close(fd);
+            return 1;
+        }
+
+        printf("Reading %s records. Ctrl+C to exit.\n", argv[2]);
+        while (1) {
+            /* Blocking read, the records are never bigger than a sample */
+            nread = read(fd, samples, sizeof(samples));
+            if (nread < 0) {
+                perror("read");
+                break;
+            }
+            print_records((const char *)samples, nread, format, &sync_ns);
+        }
+        close(fd);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "-C") == 0 && argc == 4) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        out = open(argv[3], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) {
+            perror("open capture");
+            close(fd);
+            return 1;
+        }
+
+        remaining = atol(argv[2]);
+        while (remaining > 0) {
+            nread = read(fd, samples, sizeof(samples));
+            if (nread < 0) {
+                perror("read");
+                break;
+            }
+            if (write(out, samples, nread) != nread) {
+                perror("write capture");
+                break;
+            }
+            remaining -= nread / (ssize_t)sizeof(samples[0]);
+        }
+        close(out);
+        close(fd);
+        return remaining > 0;
+    }
+
+    if (strcmp(argv[1], "-w") == 0 && argc == 3) {
+        fd = open(DEVICE_FILE, O_WRONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        in = open(argv[2], O_RDONLY);
+        if (in < 0) {
+            perror("open capture");
+            close(fd);
+            return 1;
+        }
+
+        /* write() blocks while the replay queue is full */
+        while ((nread = read(in, samples, sizeof(samples))) > 0) {
+            if (write(fd, samples, nread) != nread) {
+                perror("write device");
+                break;
+            }
+        }
+        printf("Queued %s for replay.\n", argv[2]);
+        close(in);
+        close(fd);
+        return nread != 0;
+    }
+
+    if (strcmp(argv[1], "-l") == 0 && argc == 3) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+
+        /* Blocking reads, so the latency includes the wakeup path */
+        remaining = atol(argv[2]);
+        while (remaining > 0) {
+            nread = read(fd, samples, sizeof(samples));
+            if (nread < 0) {
+                perror("read");
+                close(fd);
+                return 1;
+            }
+            remaining -= nread / (ssize_t)sizeof(samples[0]);
+        }
+
+        if (ioctl(fd, SIMTEMP_IOC_GET_LATENCY, &lat) < 0) {
+            perror("ioctl");
+            close(fd);
+            return 1;
+        }
+        print_latency(&lat);
+        close(fd);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "-W") == 0 && argc == 4) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        memset(&wakeup, 0, sizeof(wakeup));
+        wakeup.lowat = atoi(argv[2]);
+        wakeup.max_latency_ns = (__u64)atol(argv[3]) * 1000;
+        if (ioctl(fd, SIMTEMP_IOC_SET_WAKEUP, &wakeup) < 0) {
+            perror("ioctl");
+            close(fd);
+            return 1;
+        }
+
+        /* One line per wakeup shows how many samples each one delivered */
+        printf("Blocking reads, lowat=%u max_latency=%sus. Ctrl+C to exit.\n",
+            wakeup.lowat, argv[3]);
+        while (1) {
+            nread = read(fd, samples, sizeof(samples));
+            if (nread < 0) {
+                perror("read");
+                break;
+            }
+            printf("woke up with %zd samples\n",
+                nread / (ssize_t)sizeof(samples[0]));
+        }
+        close(fd);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "-U") == 0 && argc == 3) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        ret = run_uring_reader(fd, atol(argv[2]));
+        close(fd);
+        return ret;
+    }
+
+    if (strcmp(argv[1], "-S") == 0 && argc == 4) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        ret = run_splice(fd, atol(argv[2]), argv[3]);
+        close(fd);
+        return ret;
+    }
+
+    if (strcmp(argv[1], "-g") == 0) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        if (ioctl(fd, SIMTEMP_IOC_GET_CONFIG, &dev_cfg) < 0 ||
+            ioctl(fd, SIMTEMP_IOC_GET_STATS, &stats) < 0 ||
+            ioctl(fd, SIMTEMP_IOC_GET_COUNTERS, &counters) < 0) {
+            perror("ioctl");
+            close(fd);
+            return 1;
+        }
+        /* No newest sample before the generator produced one */
+        ret = ioctl(fd, SIMTEMP_IOC_GET_LATEST, &latest);
+        print_device(&dev_cfg, &stats, &counters,
+            ret == 0 ? &latest : NULL);
+        close(fd);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "-F") == 0 && argc == 3) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        /* Start from the current values, only the given fields change */
+        if (ioctl(fd, SIMTEMP_IOC_GET_CONFIG, &dev_cfg) < 0) {
+            perror("ioctl");
+            close(fd);
+            return 1;
+        }
+        dev_cfg.mask = 0;
+        for (token = strtok_r(argv[2], ",", &saveptr1); token;
+            token = strtok_r(NULL, ",", &saveptr1)) {
+            if (set_config_field(&dev_cfg, token) < 0) {
+                fprintf(stderr, "Unknown config field: %s\n", token);
+                close(fd);
+                return 1;
             }
         }
+        if (ioctl(fd, SIMTEMP_IOC_SET_FIELDS, &dev_cfg) < 0) {
+            perror("ioctl");
+            close(fd);
+            return 1;
+        }
+        printf("Set config fields 0x%x via ioctl.\n", dev_cfg.mask);
+        close(fd);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "-k") == 0 && (argc == 2 || argc == 3)) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        ret = run_clock(fd, argc == 3 ? argv[2] : NULL);
+        close(fd);
+        return ret;
+    }
+
+    if (strcmp(argv[1], "-n") == 0 && argc == 3) {
+        return run_netlink_listener(argv[2]);
+    }
+
+    if (strcmp(argv[1], "-a") == 0) {
+        fd = open(DEVICE_FILE, O_RDONLY);
+        if (fd < 0) {
+            perror("open device");
+            return 1;
+        }
+        if (ioctl(fd, SIMTEMP_IOC_GET_AGGREGATE, &agg) < 0) {
+            perror("ioctl");
+            close(fd);
+            return 1;
+        }
+        printf("window=%ums ewma=%.3fC\n", agg.window_ms,
+            (float)agg.ewma_mC / 1000.0);
+        print_window("last", &agg.last);
+        print_window("current", &agg.current);
         close(fd);
         return 0;
     }
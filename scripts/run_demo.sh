@@ -94,9 +94,22 @@ fi
 print_status "info" "Validating sysfs paths and permissions..."
 
 check_permissions "${SYSFS_DIR}/sampling_ms" "rw"
+check_permissions "${SYSFS_DIR}/sampling_us" "rw"
+check_permissions "${SYSFS_DIR}/sampling_ns" "rw"
 check_permissions "${SYSFS_DIR}/threshold_mC" "rw"
+check_permissions "${SYSFS_DIR}/hysteresis_mC" "rw"
 check_permissions "${SYSFS_DIR}/mode" "rw"
+check_permissions "${SYSFS_DIR}/seed" "rw"
+check_permissions "${SYSFS_DIR}/replay_speed" "rw"
+check_permissions "${SYSFS_DIR}/overflow_policy" "rw"
+check_permissions "${SYSFS_DIR}/fifo_depth" "rw"
+check_permissions "${SYSFS_DIR}/gen_context" "rw"
+check_permissions "${SYSFS_DIR}/gen_cpu" "rw"
+check_permissions "${SYSFS_DIR}/window_ms" "rw"
+check_permissions "${SYSFS_DIR}/aggregate" "ro"
 check_permissions "${SYSFS_DIR}/stats" "ro"
+check_permissions "${SYSFS_DIR}/counters" "ro"
+check_permissions "${SYSFS_DIR}/timestamp_clock" "rw"
 
 # --- Run test tool commands ---
 print_status "info" "Running test tool commands and validating sysfs values..."
@@ -110,6 +123,62 @@ else
     print_status "error" "Failed to set sampling_ms to 1000."
 fi
 
+# Test 1b: Set sampling_us to 500
+"${TEST_TOOL}" -u 500
+if [ "$(cat "${SYSFS_DIR}/sampling_ns")" -eq 500000 ]; then
+    print_status "ok" "sampling_us was successfully set to 500."
+else
+    print_status "info" "Current value: $(cat "${SYSFS_DIR}/sampling_ns")"
+    print_status "error" "Failed to set sampling_us to 500."
+fi
+
+# Test 1c: Generate samples from the SCHED_FIFO kthread and back
+echo kthread > "${SYSFS_DIR}/gen_context"
+if [ "$(cat "${SYSFS_DIR}/gen_context")" = "kthread" ]; then
+    print_status "ok" "gen_context was successfully set to kthread."
+else
+    print_status "error" "Failed to set gen_context to kthread."
+fi
+echo hardirq > "${SYSFS_DIR}/gen_context"
+
+# Test 1d: Select the drop-newest overflow policy and back
+echo drop-newest > "${SYSFS_DIR}/overflow_policy"
+if [ "$(cat "${SYSFS_DIR}/overflow_policy")" = "drop-newest" ]; then
+    print_status "ok" "overflow_policy was successfully set to drop-newest."
+else
+    print_status "error" "Failed to set overflow_policy to drop-newest."
+fi
+echo drop-oldest > "${SYSFS_DIR}/overflow_policy"
+
+# Test 1e: Resize the sample history, non power of 2 depths round up
+echo 1000 > "${SYSFS_DIR}/fifo_depth"
+if [ "$(cat "${SYSFS_DIR}/fifo_depth")" -eq 1024 ]; then
+    print_status "ok" "fifo_depth was successfully set to 1024."
+else
+    print_status "info" "Current value: $(cat "${SYSFS_DIR}/fifo_depth")"
+    print_status "error" "Failed to set fifo_depth to 1024."
+fi
+echo 256 > "${SYSFS_DIR}/fifo_depth"
+
+# Test 1f: Shorten the aggregation window and back
+echo 100 > "${SYSFS_DIR}/window_ms"
+if [ "$(cat "${SYSFS_DIR}/window_ms")" -eq 100 ]; then
+    print_status "ok" "window_ms was successfully set to 100."
+else
+    print_status "info" "Current value: $(cat "${SYSFS_DIR}/window_ms")"
+    print_status "error" "Failed to set window_ms to 100."
+fi
+echo 1000 > "${SYSFS_DIR}/window_ms"
+
+# Test 1g: Stamp samples with CLOCK_MONOTONIC and back
+echo monotonic > "${SYSFS_DIR}/timestamp_clock"
+if [ "$(cat "${SYSFS_DIR}/timestamp_clock")" = "monotonic" ]; then
+    print_status "ok" "timestamp_clock was successfully set to monotonic."
+else
+    print_status "error" "Failed to set timestamp_clock to monotonic."
+fi
+echo realtime > "${SYSFS_DIR}/timestamp_clock"
+
 # Test 2: Set threshold_mC to 30000
 "${TEST_TOOL}" -t 30000
 if [ "$(cat "${SYSFS_DIR}/threshold_mC")" -eq 30000 ]; then
@@ -119,6 +188,15 @@ else
     print_status "error" "Failed to set threshold_mC to 30000."
 fi
 
+# Test 2b: Set hysteresis_mC to 2000
+echo 2000 > "${SYSFS_DIR}/hysteresis_mC"
+if [ "$(cat "${SYSFS_DIR}/hysteresis_mC")" -eq 2000 ]; then
+    print_status "ok" "hysteresis_mC was successfully set to 2000."
+else
+    print_status "info" "Current value: $(cat "${SYSFS_DIR}/hysteresis_mC")"
+    print_status "error" "Failed to set hysteresis_mC to 2000."
+fi
+
 # Test 3: Set mode to ramp
 "${TEST_TOOL}" -m ramp
 if [ "$(cat "${SYSFS_DIR}/mode")" == "ramp" ]; then
@@ -128,6 +206,49 @@ else
     print_status "error" "Failed to set mode to ramp."
 fi
 
+# Test 4: Same seed, same waveform
+"${TEST_TOOL}" -m sine
+echo 1234 > "${SYSFS_DIR}/seed"
+if [ "$(cat "${SYSFS_DIR}/seed")" -eq 1234 ] && \
+    [ "$(cat "${SYSFS_DIR}/mode")" == "sine" ]; then
+    print_status "ok" "mode sine with seed 1234 was successfully set."
+else
+    print_status "error" "Failed to set mode sine with seed 1234."
+fi
+
+# Test 5: IIO front-end, only registered on kernels with IIO buffers
+IIO_DIR=$(grep -lx simtemp0 /sys/bus/iio/devices/iio:device*/name 2>/dev/null \
+    | head -n 1 | xargs -r dirname)
+if [ -z "${IIO_DIR}" ]; then
+    print_status "info" "No IIO device for simtemp0, skipping IIO test."
+elif [ "$(cat "${IIO_DIR}/in_temp_scale")" -eq 1 ] && \
+    [ -n "$(cat "${IIO_DIR}/in_temp_raw")" ]; then
+    print_status "ok" "IIO device ${IIO_DIR} reports in_temp_raw."
+else
+    print_status "error" "IIO device ${IIO_DIR} has no temperature channel."
+fi
+if [ -n "${IIO_DIR}" ]; then
+    IIO_TRIG=$(cat "${IIO_DIR}/trigger/current_trigger")
+    if [ "${IIO_TRIG}" = "simtemp0-sample" ]; then
+        print_status "ok" "IIO buffer is fed by the simtemp0-sample trigger."
+    else
+        print_status "error" "IIO buffer has no simtemp0-sample trigger."
+    fi
+fi
+
+# Test 6: hwmon front-end, temp1_max follows threshold_mC
+HWMON_DIR=$(grep -lx simtemp0 /sys/class/hwmon/hwmon*/name 2>/dev/null \
+    | head -n 1 | xargs -r dirname)
+if [ -z "${HWMON_DIR}" ]; then
+    print_status "info" "No hwmon device for simtemp0, skipping hwmon test."
+elif [ "$(cat "${HWMON_DIR}/temp1_max")" -eq \
+    "$(cat "${SYSFS_DIR}/threshold_mC")" ] && \
+    [ -n "$(cat "${HWMON_DIR}/temp1_input")" ]; then
+    print_status "ok" "hwmon device ${HWMON_DIR} reports temp1_input."
+else
+    print_status "error" "hwmon device ${HWMON_DIR} does not match sysfs."
+fi
+
 # --- Remove the module ---
 print_status "info" "Removing module ${MODULE_NAME} with rmmod..."
 rmmod "${MODULE_NAME}"
@@ -6,15 +6,17 @@
 MODULE_NAME="simtemp"
 SYSFS_PATH="/sys/devices/platform/${MODULE_NAME}"
 
-CHAR_DEV="/dev/${MODULE_NAME}"
+CHAR_DEV="/dev/${MODULE_NAME}0"
 VAR_MODE="${SYSFS_PATH}/mode"
 VAR_SAMPLING_MS="${SYSFS_PATH}/sampling_ms"
+VAR_SAMPLING_US="${SYSFS_PATH}/sampling_us"
 VAR_THRESHOLD_MC="${SYSFS_PATH}/threshold_mC"
 
 DEV_PATHS=(\
     "${CHAR_DEV}"\
     "${VAR_MODE}"\
     "${VAR_SAMPLING_MS}"\
+    "${VAR_SAMPLING_US}"\
     "${VAR_THRESHOLD_MC}"\
 )
 FILE_MOD="646"
@@ -9,10 +9,17 @@ This program bypassed all parameters to the testing application
 Usage: python3 main.py [options]
 Options:
   -s <ms>           Set sampling period via sysfs.
+  -u <us>           Set sampling period in microseconds via sysfs.
   -t <mC>           Set threshold via sysfs.
-  -m <mode>         Set mode via sysfs (normal|ramp).
-  -i <ms>:<mC>:<mode>  Set all via ioctl (mode: 0=normal, 1=ramp).
+  -m <mode>         Set mode via sysfs (normal|ramp|sine|sawtooth|step|noise|replay).
+  -i <ms>:<mC>:<mode>  Set all via ioctl (mode: 0=normal, 1=ramp, 2=sine, 3=sawtooth,
+                       4=step, 5=noise, 6=replay).
   -p                Run in poll loop, printing samples and alerts.
+  -r                Run in poll loop, consuming samples from the mmap() ring.
+  -f <fmt>          Run in poll loop, reading compact|raw records.
+  -C <n> <file>     Capture <n> samples into <file>.
+  -w <file>         Replay the samples captured in <file> (needs mode replay).
+  -l <n>            Read <n> samples and print their delivery latency.
 
 Resources:
 
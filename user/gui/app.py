@@ -8,9 +8,9 @@ This Python 3 application uses Tkinter to create a temperature gauge.
 
 Temperature gauge provides following features:
 
-    * It reads binary data from a simulated character device /dev/simtemp and
-      adjusts device parameters by writing to SysFS files in
-      /sys/devices/platform/.
+    * It reads binary data from a simulated character device /dev/simtemp0 and
+      adjusts device parameters through its SIMTEMP_IOC_GET_CONFIG and
+      SIMTEMP_IOC_SET_FIELDS ioctls, one call per update.
 
     * The application uses multithreading to read from the device without
       freezing the GUI and includes an animated gauge widget to visualize
@@ -31,6 +31,7 @@ import tkinter as tk
 from tkinter import ttk
 from threading import Thread, Event
 import struct
+import fcntl
 from enum import Enum
 import time
 import math
@@ -39,10 +40,8 @@ import math
 
 # Configuration and file paths
 DEV = "simtemp"
-DEV_TEMP = "/dev/" + DEV
-SYSFS_SAMPLING_MS = "/sys/devices/platform/" + DEV + "/sampling_ms"
-SYSFS_THRESHOLD_MC = "/sys/devices/platform/" + DEV + "/threshold_mC"
-SYSFS_MODE = "/sys/devices/platform/" + DEV + "/mode"
+DEV_TEMP = "/dev/" + DEV + "0"
+MODES = ["normal", "ramp", "sine", "sawtooth", "step", "noise", "replay"]
 
 # Data structure definition for the binary data from the device
 # We use '<QIHx' for little-endian:
@@ -57,6 +56,32 @@ SIMTEMP_SIZE = struct.calcsize(SIMTEMP_FORMAT)
 FLAG_NEW_SAMPLE = 0b01
 FLAG_THRESHOLD_CROSSED = 0b10
 
+# struct simtemp_dev_config, see nxp_simtemp_ioctl.h:
+# version, mask, sampling_ns, seed, threshold_mC, hysteresis_mC, mode,
+# overflow_policy, fifo_depth, gen_context, gen_cpu, window_ms,
+# replay_speed, reserved
+DEV_CONFIG_FORMAT = '<IIQQIIIIIIiIII'
+DEV_CONFIG_SIZE = struct.calcsize(DEV_CONFIG_FORMAT)
+DEV_CONFIG_VERSION = 1
+CFG_F_SAMPLING_NS = 1 << 0
+CFG_F_THRESHOLD_MC = 1 << 1
+CFG_F_MODE = 1 << 3
+
+# Linux _IOC() encoding with the driver magic 'T'
+IOC_WRITE = 1
+IOC_READ = 2
+
+
+def simtemp_ioc(direction, number, size):
+    """
+    Builds an ioctl request number like _IOC() does.
+    """
+    return (direction << 30) | (size << 16) | (ord('T') << 8) | number
+
+
+SIMTEMP_IOC_GET_CONFIG = simtemp_ioc(IOC_READ, 12, DEV_CONFIG_SIZE)
+SIMTEMP_IOC_SET_FIELDS = simtemp_ioc(IOC_WRITE, 13, DEV_CONFIG_SIZE)
+
 ################################################################################
 
 class Label(Enum):
@@ -89,8 +114,8 @@ class TempGaugeApp:
         self.labels[Label.THRESHOLD_MC] = tk.StringVar()
         self.labels[Label.MODE] = tk.StringVar()
 
-        # Load initial values from SysFS
-        self.load_sysfs_values()
+        # Load initial values from the device
+        self.load_config()
 
         # Initialize the GUI
         self.create_widgets()
@@ -181,7 +206,7 @@ class TempGaugeApp:
         mode_combobox = ttk.Combobox(
             controls_frame,
             textvariable=self.labels[Label.MODE],
-            values=["normal", "ramp"],
+            values=MODES,
             state="readonly"
         )
         mode_combobox.grid(row=2, column=1, padx=5, pady=2)
@@ -292,75 +317,86 @@ class TempGaugeApp:
                 "Device not found!"
             )
 
-    def load_sysfs_values(self):
+    def get_config(self):
+        """
+        Reads the whole device configuration with a single ioctl.
+        """
+        with open(DEV_TEMP, "rb") as f:
+            buf = bytearray(DEV_CONFIG_SIZE)
+            fcntl.ioctl(f, SIMTEMP_IOC_GET_CONFIG, buf)
+        return list(struct.unpack(DEV_CONFIG_FORMAT, buf))
+
+    def set_fields(self, mask, index, value):
         """
-        Reads initial values from SysFS files.
+        Applies one configuration field with a single ioctl.
         """
+        cfg = [0] * len(DEV_CONFIG_FORMAT[1:])
+        cfg[0] = DEV_CONFIG_VERSION
+        cfg[1] = mask
+        cfg[index] = value
         try:
-            with open(SYSFS_SAMPLING_MS, "r", encoding="utf-8") as f:
-                self.labels[Label.SAMPLING_MS].set(f.read().strip())
-            with open(SYSFS_THRESHOLD_MC, "r", encoding="utf-8") as f:
-                self.threshold_mc = int(f.read().strip())
-                self.labels[Label.THRESHOLD_MC].set(
-                    f"{self.threshold_mc / 1000.0:.1f}"
-                )
-            with open(SYSFS_MODE, "r", encoding="utf-8") as f:
-                self.labels[Label.MODE].set(f.read().strip())
-        except (FileNotFoundError, IOError) as e:
-            print(f"Warning: Could not read SysFS files. {e}")
-            self.labels[Label.SAMPLING_MS].set("N/A")
-            self.labels[Label.THRESHOLD_MC].set("N/A")
-            self.labels[Label.MODE].set("N/A")
+            with open(DEV_TEMP, "rb") as f:
+                fcntl.ioctl(f, SIMTEMP_IOC_SET_FIELDS,
+                            struct.pack(DEV_CONFIG_FORMAT, *cfg))
+        except OSError as e:
+            print(f"Error: Could not configure {DEV_TEMP}. {e}")
 
-    def write_to_sysfs(self, path, value):
+    def load_config(self):
         """
-        Helper function to write a value to a SysFS file.
+        Shows the device configuration.
         """
         try:
-            with open(path, "w", encoding="utf-8") as f:
-                f.write(str(value))
-        except (FileNotFoundError, IOError) as e:
-            print(f"Error: Could not write to {path}. Check permissions. {e}")
+            cfg = self.get_config()
+        except OSError as e:
+            print(f"Warning: Could not read the configuration. {e}")
+            self.labels[Label.SAMPLING_MS].set("N/A")
+            self.labels[Label.THRESHOLD_MC].set("N/A")
+            self.labels[Label.MODE].set("N/A")
+            return
+
+        self.labels[Label.SAMPLING_MS].set(str(cfg[2] // 1000000))
+        self.threshold_mc = cfg[4]
+        self.labels[Label.THRESHOLD_MC].set(
+            f"{self.threshold_mc / 1000.0:.1f}"
+        )
+        mode = cfg[6]
+        self.labels[Label.MODE].set(
+            MODES[mode] if mode < len(MODES) else str(mode)
+        )
 
     def set_sampling_ms(self):
         """
-        Writes the new sampling time to SysFS.
+        Applies the new sampling time.
         """
         try:
             value = int(self.labels[Label.SAMPLING_MS].get())
-            self.write_to_sysfs(SYSFS_SAMPLING_MS, value)
-            with open(SYSFS_SAMPLING_MS, "r", encoding="utf-8") as f:
-                self.labels[Label.SAMPLING_MS].set(f.read().strip())
+            self.set_fields(CFG_F_SAMPLING_NS, 2, value * 1000000)
+            self.load_config()
         except ValueError:
             print("Invalid value for sampling time. Please enter an integer.")
 
     def set_threshold_mc(self):
         """
-        Writes the new temperature threshold to SysFS.
+        Applies the new temperature threshold.
         """
         try:
             value = int(float(self.labels[Label.THRESHOLD_MC].get()) * 1000)
-            self.write_to_sysfs(SYSFS_THRESHOLD_MC, value)
-            with open(SYSFS_THRESHOLD_MC, "r", encoding="utf-8") as f:
-                self.threshold_mc = int(f.read().strip())
-                self.labels[Label.THRESHOLD_MC].set(
-                    f"{self.threshold_mc / 1000.0:.1f}"
-                )
+            self.set_fields(CFG_F_THRESHOLD_MC, 4, value)
+            self.load_config()
             self.draw_gauge_background()
         except ValueError:
             print("Invalid value for threshold. Please enter a number.")
 
     def set_mode(self):
         """
-        Writes the new operation mode to SysFS.
+        Applies the new operation mode.
         """
         value = self.labels[Label.MODE].get()
-        if value in ["normal", "ramp"]:
-            self.write_to_sysfs(SYSFS_MODE, value)
-            with open(SYSFS_MODE, "r", encoding="utf-8") as f:
-                self.labels[Label.MODE].set(f.read().strip())
+        if value in MODES:
+            self.set_fields(CFG_F_MODE, 6, MODES.index(value))
+            self.load_config()
         else:
-            print("Invalid mode. Must be 'normal' or 'ramp'.")
+            print("Invalid mode. Must be one of: " + ", ".join(MODES) + ".")
 
 # Main application entry point
 if __name__ == "__main__":